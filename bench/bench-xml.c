@@ -0,0 +1,763 @@
+/**
+ * Copyright (c) 2012 ooxi/xml.c
+ *     https://github.com/ooxi/xml.c
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software in a
+ *     product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ *
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *
+ *  3. This notice may not be removed or altered from any source distribution.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xml.h>
+
+
+
+
+
+/**
+ * Allocations done while a phase is measured. If the linker supports symbol
+ * wrapping, CMake defines XML_BENCH_COUNT_ALLOCATIONS and every call to the
+ * system allocator is routed through the functions below
+ */
+static struct {
+	size_t mallocs;
+	size_t frees;
+	size_t bytes;
+} allocations;
+
+#ifdef XML_BENCH_COUNT_ALLOCATIONS
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+void __real_free(void* pointer);
+
+void* __wrap_malloc(size_t size) {
+	allocations.mallocs++;
+	allocations.bytes += size;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+	allocations.mallocs++;
+	allocations.bytes += count * size;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+	allocations.mallocs++;
+	allocations.bytes += size;
+	return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void* pointer) {
+	if (pointer) {
+		allocations.frees++;
+	}
+	__real_free(pointer);
+}
+#endif
+
+
+
+/**
+ * Will halt the program iff condition fails
+ */
+static void require(_Bool condition, char const* message) {
+	if (!condition) {
+		fprintf(stderr, "xml-bench: %s\n", message);
+		exit(EXIT_FAILURE);
+	}
+}
+
+
+
+/**
+ * @return Monotonic time in seconds
+ */
+static double now() {
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+
+
+/**
+ * Generated document together with the number of elements it contains
+ */
+struct corpus {
+	char* buffer;
+	size_t length;
+	size_t capacity;
+	size_t nodes;
+	uint32_t random;
+};
+
+static void corpus_append(struct corpus* corpus, char const* format, ...) {
+	for (;;) {
+		va_list arguments;
+		va_start(arguments, format);
+		int written = vsnprintf(corpus->buffer + corpus->length, corpus->capacity - corpus->length, format, arguments);
+		va_end(arguments);
+		require(written >= 0, "formatting failed");
+
+		if (corpus->length + written < corpus->capacity) {
+			corpus->length += written;
+			return;
+		}
+
+		corpus->capacity = 2 * (corpus->capacity + written);
+		corpus->buffer = realloc(corpus->buffer, corpus->capacity);
+		require(corpus->buffer, "out of memory");
+	}
+}
+
+/**
+ * Deterministic xorshift generator, every corpus starts from the same seed
+ */
+static uint32_t corpus_random(struct corpus* corpus, uint32_t limit) {
+	corpus->random ^= corpus->random << 13;
+	corpus->random ^= corpus->random >> 17;
+	corpus->random ^= corpus->random << 5;
+	return corpus->random % limit;
+}
+
+static void corpus_words(struct corpus* corpus, size_t length) {
+	static char const* const words[] = {
+		"lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+		"adipiscing", "elit", "sed", "do", "eiusmod", "tempor"
+	};
+	size_t const count = sizeof(words) / sizeof(words[0]);
+
+	size_t end = corpus->length + length;
+	corpus_append(corpus, "%s", words[corpus_random(corpus, count)]);
+	while (corpus->length < end) {
+		corpus_append(corpus, " %s", words[corpus_random(corpus, count)]);
+	}
+}
+
+
+
+/**
+ * Many small siblings below the root
+ */
+static void generate_wide(struct corpus* corpus, size_t size) {
+	corpus_append(corpus, "<root>");
+	corpus->nodes++;
+
+	while (corpus->length < size) {
+		corpus_append(corpus, "<item>");
+		corpus_words(corpus, 1 + corpus_random(corpus, 16));
+		corpus_append(corpus, "</item>");
+		corpus->nodes++;
+	}
+	corpus_append(corpus, "</root>");
+}
+
+/**
+ * Single chain of nested elements
+ */
+static void generate_deep(struct corpus* corpus, size_t size) {
+	while (2 * corpus->length < size) {
+		corpus_append(corpus, "<n d=\"%zu\">", corpus->nodes);
+		corpus->nodes++;
+	}
+
+	size_t i = 0; for (; i < corpus->nodes; ++i) {
+		corpus_append(corpus, "</n>");
+	}
+}
+
+/**
+ * Self closing elements with many attributes each
+ */
+static void generate_attributes(struct corpus* corpus, size_t size) {
+	corpus_append(corpus, "<root>");
+	corpus->nodes++;
+
+	while (corpus->length < size) {
+		corpus_append(corpus, "<e id=\"%zu\"", corpus->nodes);
+		size_t i = 0; for (; i < 8; ++i) {
+			corpus_append(corpus, " a%zu=\"", i);
+			corpus_words(corpus, 1 + corpus_random(corpus, 24));
+			corpus_append(corpus, "\"");
+		}
+		corpus_append(corpus, "/>");
+		corpus->nodes++;
+	}
+	corpus_append(corpus, "</root>");
+}
+
+/**
+ * Few elements with long text content
+ */
+static void generate_text(struct corpus* corpus, size_t size) {
+	corpus_append(corpus, "<root>");
+	corpus->nodes++;
+
+	while (corpus->length < size) {
+		corpus_append(corpus, "<p>");
+		corpus_words(corpus, 256 + corpus_random(corpus, 4096));
+		corpus_append(corpus, "</p>");
+		corpus->nodes++;
+	}
+	corpus_append(corpus, "</root>");
+}
+
+/**
+ * Indented record structure as written by most serializers
+ */
+static void generate_pretty(struct corpus* corpus, size_t size) {
+	corpus_append(corpus, "<catalog>\n");
+	corpus->nodes++;
+
+	while (corpus->length < size) {
+		corpus_append(corpus, "\t<section id=\"%zu\">\n", corpus->nodes);
+		corpus->nodes++;
+
+		size_t entries = 1 + corpus_random(corpus, 8);
+		size_t i = 0; for (; i < entries; ++i) {
+			corpus_append(corpus, "\t\t<entry key=\"k%zu\" type=\"record\">\n", i);
+			corpus_append(corpus, "\t\t\t<title>");
+			corpus_words(corpus, 8 + corpus_random(corpus, 32));
+			corpus_append(corpus, "</title>\n\t\t\t<value>%u</value>\n", corpus_random(corpus, 100000));
+			corpus_append(corpus, "\t\t</entry>\n");
+			corpus->nodes += 3;
+		}
+		corpus_append(corpus, "\t</section>\n");
+	}
+	corpus_append(corpus, "</catalog>\n");
+}
+
+
+/**
+ * Many small siblings with entity and character references in their text
+ */
+static void generate_entities(struct corpus* corpus, size_t size) {
+	static char const* const references[] = {
+		"&amp;", "&lt;b&gt;", "&quot;", "&#169;", "&#x20AC;"
+	};
+	size_t const count = sizeof(references) / sizeof(references[0]);
+
+	corpus_append(corpus, "<root>");
+	corpus->nodes++;
+
+	while (corpus->length < size) {
+		corpus_append(corpus, "<item>");
+		corpus_words(corpus, 1 + corpus_random(corpus, 16));
+		corpus_append(corpus, " %s ", references[corpus_random(corpus, count)]);
+		corpus_words(corpus, 1 + corpus_random(corpus, 16));
+		corpus_append(corpus, "</item>");
+		corpus->nodes++;
+	}
+	corpus_append(corpus, "</root>");
+}
+
+
+
+/**
+ * Available corpora
+ */
+static struct {
+	char const* name;
+	void (*generate)(struct corpus* corpus, size_t size);
+} const generators[] = {
+	{"wide", generate_wide},
+	{"deep", generate_deep},
+	{"attributes", generate_attributes},
+	{"text", generate_text},
+	{"pretty", generate_pretty},
+	{"entities", generate_entities}
+};
+
+
+
+/**
+ * Accumulates values computed by the benchmarks, so the compiler cannot drop
+ * the computations
+ */
+static volatile size_t bench_sink = 0;
+
+
+
+/**
+ * Visits every node without recursion, touching names, contents and
+ * attributes the way a consumer of the tree would
+ *
+ * @return Number of visited nodes
+ */
+static size_t traverse(struct xml_node* root, struct xml_node** stack) {
+	size_t visited = 0;
+	size_t touched = 0;
+	size_t length = 0;
+
+	stack[length++] = root;
+	while (length) {
+		struct xml_node* node = stack[--length];
+		visited++;
+
+		touched += xml_string_length(xml_node_name(node));
+		touched += xml_string_length(xml_node_content(node));
+
+		size_t attributes = xml_node_attributes(node);
+		size_t i = 0; for (; i < attributes; ++i) {
+			touched += xml_string_length(xml_node_attribute_content(node, i));
+		}
+
+		size_t children = xml_node_children(node);
+		for (i = children; i > 0; --i) {
+			stack[length++] = xml_node_child(node, i - 1);
+		}
+	}
+
+	/* Keep the compiler from dropping the accesses
+	 */
+	bench_sink += touched;
+	return visited;
+}
+
+
+
+/**
+ * Best timing of one phase over all iterations, allocations are those of the
+ * last iteration
+ */
+struct phase {
+	double seconds;
+	size_t mallocs;
+	size_t frees;
+	size_t bytes;
+};
+
+static void phase_begin(double* start) {
+	allocations.mallocs = 0;
+	allocations.frees = 0;
+	allocations.bytes = 0;
+	*start = now();
+}
+
+static void phase_end(struct phase* phase, double start) {
+	double seconds = now() - start;
+
+	if (seconds < phase->seconds) {
+		phase->seconds = seconds;
+	}
+	phase->mallocs = allocations.mallocs;
+	phase->frees = allocations.frees;
+	phase->bytes = allocations.bytes;
+}
+
+static void phase_print(char const* name, struct phase* phase, struct corpus* corpus, _Bool last) {
+	fprintf(stdout, "\t\t\t\"%s\": {\"seconds\": %.9f, \"mb_per_s\": %.3f, \"ns_per_node\": %.3f, ",
+		name, phase->seconds,
+		corpus->length / phase->seconds / 1e6,
+		phase->seconds * 1e9 / corpus->nodes
+	);
+#ifdef XML_BENCH_COUNT_ALLOCATIONS
+	fprintf(stdout, "\"mallocs\": %zu, \"frees\": %zu, \"malloc_bytes\": %zu}", phase->mallocs, phase->frees, phase->bytes);
+#else
+	fprintf(stdout, "\"mallocs\": null, \"frees\": null, \"malloc_bytes\": null}");
+#endif
+	fprintf(stdout, "%s\n", last ? "" : ",");
+}
+
+
+
+/**
+ * Measures all phases on one corpus and prints the results as JSON object
+ */
+static void bench(char const* name, void (*generate)(struct corpus*, size_t), size_t size, size_t iterations, size_t threads, _Bool last) {
+	struct corpus corpus = {0};
+	corpus.random = 2463534242u;
+	generate(&corpus, size);
+
+	struct xml_node** stack = malloc(corpus.nodes * sizeof(struct xml_node*));
+	require(stack, "out of memory");
+
+	/* Decoding modifies the buffer, so it works on a copy. Written documents
+	 * may be slightly longer than the corpus
+	 */
+	uint8_t* copy = malloc(corpus.length);
+	uint8_t* output = malloc(corpus.length + 64);
+	require(copy && output, "out of memory");
+
+	struct phase parse = {.seconds = 1e9}, reuse = {.seconds = 1e9}, validate = {.seconds = 1e9}, lazy = {.seconds = 1e9}, parallel = {.seconds = 1e9}, decode = {.seconds = 1e9}, open = {.seconds = 1e9}, traversal = {.seconds = 1e9}, write = {.seconds = 1e9}, copying = {.seconds = 1e9}, release = {.seconds = 1e9};
+	struct xml_options lazy_options = {0};
+	lazy_options.lazy = true;
+	struct xml_options parallel_options = {0};
+	parallel_options.threads = threads;
+	struct xml_options decode_options = {0};
+	decode_options.decode = true;
+	size_t memory = 0;
+	double start;
+
+	struct xml_document_parser* parser = xml_document_parser_create(0);
+	require(parser, "out of memory");
+
+	size_t i = 0; for (; i < iterations; ++i) {
+
+		/* Parse from memory
+		 */
+		phase_begin(&start);
+		struct xml_document* document = xml_parse_document((uint8_t*)corpus.buffer, corpus.length);
+		phase_end(&parse, start);
+		require(document, "could not parse corpus");
+
+		phase_begin(&start);
+		size_t visited = traverse(xml_document_root(document), stack);
+		phase_end(&traversal, start);
+		require(visited == corpus.nodes, "traversal missed nodes");
+		memory = xml_document_memory(document);
+
+		/* Write back with a single leaf in the middle modified, compared
+		 * to copying the corpus
+		 */
+		struct xml_node* leaf = xml_document_root(document);
+		while (xml_node_children(leaf)) {
+			leaf = xml_node_child(leaf, xml_node_children(leaf) / 2);
+		}
+		require(xml_node_set_content(leaf, (uint8_t const*)"modified", 8), "could not modify corpus");
+
+		phase_begin(&start);
+		size_t written = xml_document_write_buffer(document, output, corpus.length + 64);
+		phase_end(&write, start);
+		require(written && (written <= corpus.length + 64), "could not write corpus");
+
+		phase_begin(&start);
+		memcpy(output, corpus.buffer, corpus.length);
+		phase_end(&copying, start);
+
+		phase_begin(&start);
+		xml_document_free(document, false);
+		phase_end(&release, start);
+
+		/* Parse again reusing the memory of the previous iteration
+		 */
+		phase_begin(&start);
+		document = xml_document_parser_parse(parser, (uint8_t*)corpus.buffer, corpus.length);
+		phase_end(&reuse, start);
+		require(document, "could not parse corpus reusing the parser");
+
+		/* Check well-formedness without building a tree
+		 */
+		phase_begin(&start);
+		_Bool valid = xml_validate((uint8_t const*)corpus.buffer, corpus.length, 0);
+		phase_end(&validate, start);
+		require(valid, "could not validate corpus");
+
+		/* Only find the extent of the root element
+		 */
+		phase_begin(&start);
+		document = xml_parse_document_ex((uint8_t*)corpus.buffer, corpus.length, &lazy_options);
+		phase_end(&lazy, start);
+		require(document, "could not parse corpus lazily");
+		xml_document_free(document, false);
+
+		/* Split between threads
+		 */
+		phase_begin(&start);
+		document = xml_parse_document_ex((uint8_t*)corpus.buffer, corpus.length, &parallel_options);
+		phase_end(&parallel, start);
+		require(document, "could not parse corpus in parallel");
+		xml_document_free(document, false);
+
+		/* Decode references in place
+		 */
+		memcpy(copy, corpus.buffer, corpus.length);
+		phase_begin(&start);
+		document = xml_parse_document_ex(copy, corpus.length, &decode_options);
+		phase_end(&decode, start);
+		require(document, "could not parse corpus while decoding");
+		xml_document_free(document, false);
+
+		/* Read from a stream, including the copy into memory
+		 */
+		FILE* source = tmpfile();
+		require(source, "could not create temporary file");
+		require(corpus.length == fwrite(corpus.buffer, 1, corpus.length, source), "could not write temporary file");
+		rewind(source);
+
+		phase_begin(&start);
+		document = xml_open_document(source);
+		phase_end(&open, start);
+		require(document, "could not open corpus");
+		xml_document_free(document, true);
+	}
+
+	fprintf(stdout, "\t\t{\n");
+	fprintf(stdout, "\t\t\t\"name\": \"%s\",\n", name);
+	fprintf(stdout, "\t\t\t\"bytes\": %zu,\n", corpus.length);
+	fprintf(stdout, "\t\t\t\"nodes\": %zu,\n", corpus.nodes);
+	fprintf(stdout, "\t\t\t\"document_bytes\": %zu,\n", memory);
+	fprintf(stdout, "\t\t\t\"document_bytes_per_node\": %.3f,\n", (double)memory / corpus.nodes);
+	phase_print("parse", &parse, &corpus, false);
+	phase_print("parse_reuse", &reuse, &corpus, false);
+	phase_print("validate", &validate, &corpus, false);
+	phase_print("parse_lazy", &lazy, &corpus, false);
+	phase_print("parse_parallel", &parallel, &corpus, false);
+	phase_print("parse_decode", &decode, &corpus, false);
+	phase_print("open", &open, &corpus, false);
+	phase_print("traverse", &traversal, &corpus, false);
+	phase_print("write", &write, &corpus, false);
+	phase_print("memcpy", &copying, &corpus, false);
+	phase_print("free", &release, &corpus, true);
+	fprintf(stdout, "\t\t}%s\n", last ? "" : ",");
+
+	xml_document_parser_free(parser);
+	free(copy);
+	free(output);
+	free(stack);
+	free(corpus.buffer);
+}
+
+
+
+/**
+ * Orders latencies ascending
+ */
+static int compare_seconds(void const* a, void const* b) {
+	double const x = *(double const*)a;
+	double const y = *(double const*)b;
+
+	return (x > y) - (x < y);
+}
+
+
+
+/**
+ * Generates `documents' independent documents of about `size' bytes each into
+ * one corpus
+ *
+ * @return Inputs of a batch referencing the corpus
+ */
+static struct xml_batch_input* generate_batch(struct corpus* corpus, size_t documents, size_t size) {
+	struct xml_batch_input* inputs = malloc(documents * sizeof(struct xml_batch_input));
+	size_t* offsets = malloc(documents * sizeof(size_t));
+	require(inputs && offsets, "out of memory");
+
+	/* Documents are generated back to back, the buffer may move meanwhile
+	 */
+	size_t i = 0; for (; i < documents; ++i) {
+		offsets[i] = corpus->length;
+		generate_wide(corpus, corpus->length + size);
+	}
+	for (i = 0; i < documents; ++i) {
+		inputs[i].buffer = (uint8_t*)corpus->buffer + offsets[i];
+		inputs[i].length = ((i + 1 < documents) ? offsets[i + 1] : corpus->length) - offsets[i];
+	}
+
+	free(offsets);
+	return inputs;
+}
+
+
+
+/**
+ * Measures a batch of small independent documents, parsed one after another
+ * and by xml_parse_batch, and prints the results as JSON object
+ */
+static void bench_batch(size_t documents, size_t size, size_t iterations, size_t threads) {
+	struct corpus corpus = {0};
+	corpus.random = 2463534242u;
+
+	struct xml_batch_input* inputs = generate_batch(&corpus, documents, size);
+	struct xml_batch_output* outputs = malloc(documents * sizeof(struct xml_batch_output));
+	double* latencies = malloc(documents * sizeof(double));
+	require(outputs && latencies, "out of memory");
+	size_t i;
+
+	struct phase loop = {.seconds = 1e9}, batch = {.seconds = 1e9};
+	struct xml_options options = {0};
+	options.threads = threads;
+	double start;
+
+	size_t iteration = 0; for (; iteration < iterations; ++iteration) {
+		phase_begin(&start);
+		for (i = 0; i < documents; ++i) {
+			outputs[i].document = xml_parse_document(inputs[i].buffer, inputs[i].length);
+		}
+		phase_end(&loop, start);
+
+		for (i = 0; i < documents; ++i) {
+			require(outputs[i].document, "could not parse document");
+			xml_document_free(outputs[i].document, false);
+		}
+
+		phase_begin(&start);
+		size_t parsed = xml_parse_batch(inputs, documents, outputs, &options);
+		phase_end(&batch, start);
+		require(parsed == documents, "could not parse batch");
+
+		for (i = 0; i < documents; ++i) {
+			latencies[i] = outputs[i].seconds;
+			xml_document_free(outputs[i].document, false);
+		}
+	}
+	qsort(latencies, documents, sizeof(double), compare_seconds);
+
+	fprintf(stdout, "\t\"batch\": {\n");
+	fprintf(stdout, "\t\t\"documents\": %zu,\n", documents);
+	fprintf(stdout, "\t\t\"bytes\": %zu,\n", corpus.length);
+	fprintf(stdout, "\t\t\"nodes\": %zu,\n", corpus.nodes);
+	fprintf(stdout, "\t\t\"latency_p50_us\": %.3f,\n", latencies[documents / 2] * 1e6);
+	fprintf(stdout, "\t\t\"latency_p99_us\": %.3f,\n", latencies[documents * 99 / 100] * 1e6);
+	phase_print("parse_loop", &loop, &corpus, false);
+	phase_print("parse_batch", &batch, &corpus, true);
+	fprintf(stdout, "\t},\n");
+
+	free(latencies);
+	free(outputs);
+	free(inputs);
+	free(corpus.buffer);
+}
+
+
+
+/**
+ * Measures parallel parsing of one large document and batch parsing of many
+ * small ones on pools of 1, 2, 4, ... up to `threads' threads and prints the
+ * speedup over a single thread as JSON array. Threads are started once per
+ * row, not per document
+ */
+static void bench_scaling(size_t size, size_t iterations, size_t threads) {
+	struct corpus large = {0}, small = {0};
+	large.random = small.random = 2463534242u;
+	generate_wide(&large, size);
+
+	size_t const documents = size / 1024;
+	struct xml_batch_input* inputs = generate_batch(&small, documents, 1024);
+	struct xml_batch_output* outputs = malloc(documents * sizeof(struct xml_batch_output));
+	require(outputs, "out of memory");
+
+	double parallel_single = 0, batch_single = 0;
+
+	fprintf(stdout, "\t\"scaling\": [\n");
+	size_t row = 1; for (;;) {
+		struct phase parallel = {.seconds = 1e9}, batch = {.seconds = 1e9};
+		struct xml_options options = {0};
+		options.threads = row;
+		options.pool = xml_pool_create(&options);
+		require(options.pool, "out of memory");
+		double start;
+
+		size_t iteration = 0; for (; iteration < iterations; ++iteration) {
+			phase_begin(&start);
+			struct xml_document* document = xml_parse_document_ex((uint8_t*)large.buffer, large.length, &options);
+			phase_end(&parallel, start);
+			require(document, "could not parse corpus in parallel");
+			xml_document_free(document, false);
+
+			phase_begin(&start);
+			size_t parsed = xml_parse_batch(inputs, documents, outputs, &options);
+			phase_end(&batch, start);
+			require(parsed == documents, "could not parse batch");
+
+			size_t i = 0; for (; i < documents; ++i) {
+				xml_document_free(outputs[i].document, false);
+			}
+		}
+		xml_pool_free(options.pool);
+
+		if (1 == row) {
+			parallel_single = parallel.seconds;
+			batch_single = batch.seconds;
+		}
+		fprintf(stdout, "\t\t{\"threads\": %zu, \"parse_parallel_mb_per_s\": %.3f, \"parse_parallel_speedup\": %.3f, \"parse_batch_mb_per_s\": %.3f, \"parse_batch_speedup\": %.3f}%s\n",
+			row,
+			large.length / parallel.seconds / 1e6, parallel_single / parallel.seconds,
+			small.length / batch.seconds / 1e6, batch_single / batch.seconds,
+			(row < threads) ? "," : ""
+		);
+		if (row == threads) {
+			break;
+		}
+		row = (2 * row < threads) ? 2 * row : threads;
+	}
+	fprintf(stdout, "\t]\n");
+
+	free(outputs);
+	free(inputs);
+	free(large.buffer);
+	free(small.buffer);
+}
+
+
+
+/**
+ * Console interface
+ *
+ *     xml-bench [--size BYTES] [--iterations N] [--threads N] [CORPUS...]
+ *
+ * Without corpus names all corpora are measured
+ */
+int main(int argc, char** argv) {
+	size_t const corpora = sizeof(generators) / sizeof(generators[0]);
+	size_t size = 8 * 1024 * 1024;
+	size_t iterations = 5;
+	size_t threads = 4;
+	_Bool selected[sizeof(generators) / sizeof(generators[0])] = {false};
+	_Bool any = false;
+
+	int i = 1; for (; i < argc; ++i) {
+		if (!strcmp(argv[i], "--size") && (i + 1 < argc)) {
+			size = strtoull(argv[++i], 0, 10);
+		} else if (!strcmp(argv[i], "--iterations") && (i + 1 < argc)) {
+			iterations = strtoull(argv[++i], 0, 10);
+		} else if (!strcmp(argv[i], "--threads") && (i + 1 < argc)) {
+			threads = strtoull(argv[++i], 0, 10);
+		} else {
+			size_t j = 0; for (; j < corpora; ++j) {
+				if (!strcmp(argv[i], generators[j].name)) {
+					selected[j] = any = true;
+					break;
+				}
+			}
+			require(j < corpora, "usage: xml-bench [--size BYTES] [--iterations N] [--threads N] [wide|deep|attributes|text|pretty|entities...]");
+		}
+	}
+	require(size && iterations, "size and iterations must not be zero");
+
+	size_t last = 0;
+	size_t j = 0; for (; j < corpora; ++j) {
+		if (!any || selected[j]) {
+			last = j;
+		}
+	}
+
+	fprintf(stdout, "{\n");
+	fprintf(stdout, "\t\"size\": %zu,\n", size);
+	fprintf(stdout, "\t\"iterations\": %zu,\n", iterations);
+	fprintf(stdout, "\t\"threads\": %zu,\n", threads);
+	fprintf(stdout, "\t\"corpora\": [\n");
+	for (j = 0; j < corpora; ++j) {
+		if (!any || selected[j]) {
+			bench(generators[j].name, generators[j].generate, size, iterations, threads, j == last);
+		}
+	}
+	fprintf(stdout, "\t],\n");
+	bench_batch(size / 1024, 1024, iterations, threads);
+	bench_scaling(size, iterations, threads ? threads : 1);
+	fprintf(stdout, "}\n");
+
+	return EXIT_SUCCESS;
+}
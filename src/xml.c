@@ -20,13 +20,38 @@
  *
  *  3. This notice may not be removed or altered from any source distribution.
  */
+#if !defined(_POSIX_C_SOURCE) && (defined(__unix__) || defined(__APPLE__))
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include "xml.h"
 
 #ifdef XML_PARSER_VERBOSE
 #include <alloca.h>
 #endif
 
-#include <ctype.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define XML_PARSER_POSIX
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(XML_PARSER_POSIX) && !defined(XML_PARSER_NO_THREADS)
+#define XML_PARSER_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(XML_PARSER_NO_SIMD)
+#define XML_PARSER_X86_KERNELS
+#include <immintrin.h>
+#endif
 
 #ifndef __MACH__
 #include <malloc.h>
@@ -34,6 +59,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -41,196 +67,583 @@
 
 
 
-/* 
- * public domain strtok_r() by Charlie Gordon
+/**
+ * [PRIVATE]
  *
- *   from comp.lang.c  9/14/2007
+ * Smallest block an xml_arena will request from the system. Following blocks
+ * grow geometrically, so a document needs O(log n) blocks
+ */
+#define XML_ARENA_MINIMUM_BLOCK_SIZE 4096
+
+/**
+ * [PRIVATE]
  *
- *      http://groups.google.com/group/comp.lang.c/msg/2ab1ecbb86646684
+ * Upper bound for the first block, which is sized according to the length of
+ * the document
+ */
+#define XML_ARENA_MAXIMUM_INITIAL_BLOCK_SIZE (1024 * 1024)
+
+/**
+ * [PRIVATE]
  *
- *     (Declaration that it's public domain):
- *      http://groups.google.com/group/comp.lang.c/msg/7c7b39328fefab9c
+ * Nodes with fewer children are searched linearly, larger ones get a child
+ * index on their first lookup by name
  */
-static char* xml_strtok_r(char *str, const char *delim, char **nextp) {
-	char *ret;
+#define XML_NODE_INDEX_MINIMUM_CHILDREN 16
 
-	if (str == NULL) {
-		str = *nextp;
-	}
+/**
+ * [PRIVATE]
+ *
+ * Smallest number of bytes worth a thread of its own when parsing a document
+ * in parallel
+ */
+#define XML_PARALLEL_MINIMUM_CHUNK_SIZE (256 * 1024)
 
-	str += strspn(str, delim);
+/**
+ * [PRIVATE]
+ *
+ * Initial buffer size of xml_open_document if the size of the stream is
+ * unknown, the buffer grows geometrically
+ */
+#define XML_OPEN_DOCUMENT_CHUNK_SIZE (64 * 1024)
 
-	if (*str == '\0') {
-		return NULL;
-	}
+/**
+ * [PRIVATE]
+ *
+ * Number of chunks xml_document_write_fd hands to a single writev call,
+ * bounded by what the system accepts
+ */
+#if defined(IOV_MAX) && (IOV_MAX < 256)
+#define XML_WRITER_IOVECS IOV_MAX
+#elif defined(IOV_MAX)
+#define XML_WRITER_IOVECS 256
+#else
+#define XML_WRITER_IOVECS 16
+#endif
 
-	ret = str;
+/**
+ * [PRIVATE]
+ *
+ * Alignment of every allocation carved out of an xml_arena. Everything stored
+ * in an arena consists of pointers and integers no wider than a pointer
+ */
+#define XML_ARENA_ALIGNMENT _Alignof(void*)
 
-	str += strcspn(str, delim);
+/**
+ * [PRIVATE]
+ *
+ * Single block of memory owned by an xml_arena
+ */
+struct xml_arena_block {
+	struct xml_arena_block* next;
+	size_t capacity;
+	size_t used;
+	max_align_t data[];
+};
 
-	if (*str) {
-		*str++ = '\0';
-	}
+/**
+ * [PRIVATE]
+ *
+ * Bump allocator holding all nodes, strings, attributes and arrays of a
+ * document. Individual allocations are never freed, all blocks are released
+ * at once when the document is freed. `used' counts the bytes handed out.
+ * Blocks as well as all other memory of the document come from `allocator'
+ */
+struct xml_arena {
+	struct xml_allocator const* allocator;
+	struct xml_arena_block* blocks;
+	size_t block_size;
+	size_t used;
+};
 
-	*nextp = str;
 
-	return ret;
-}
 
+/**
+ * [OPAQUE API]
+ *
+ * UTF-8 text
+ */
+struct xml_string {
+	uint8_t const* buffer;
+	size_t length;
+};
+
+/**
+ * [PRIVATE]
+ *
+ * Interned element or attribute name. Each distinct name is stored only once
+ * per document, thus names can be compared by identity. `id' is the public
+ * symbol of the name, `hash' caches its hash value.
+ *
+ * `scratch' is only valid while a child index is built, `forward' only while
+ * the symbols of a parallel parse are merged
+ */
+struct xml_symbol {
+	struct xml_string name;
+	uint32_t id;
+	uint32_t hash;
+	struct xml_symbols* symbols;
+	struct xml_symbol* forward;
 
+	struct {
+		size_t children;
+		struct xml_node_index_slot* slot;
+	} scratch;
+};
 
+/**
+ * [PRIVATE]
+ *
+ * Symbol table of a document. `slots' is an open addressing hash table with a
+ * capacity of a power of two, the symbol with id `n' is stored at
+ * `elements[n - 1]'. Symbols themselves are allocated from the arena
+ */
+struct xml_symbols {
+	struct xml_arena* arena;
 
+	struct {
+		struct xml_symbol** elements;
+		size_t capacity;
+	} slots;
 
+	struct {
+		struct xml_symbol** elements;
+		size_t length;
+		size_t capacity;
+	} symbols;
+};
 
 /**
- * [OPAQUE API]
+ * [PRIVATE]
  *
- * UTF-8 text
+ * Children of one name are stored at `positions[offset ... offset + length)'
+ * of the child index
  */
-struct xml_string {
-	uint8_t const* buffer;
+struct xml_node_index_slot {
+	struct xml_symbol* name;
+	size_t offset;
 	size_t length;
 };
 
+/**
+ * [PRIVATE]
+ *
+ * Hash index from child name to the positions of all children with that name,
+ * built on the first lookup by name and allocated from the document's arena.
+ * `slots' is an open addressing hash table with a capacity of a power of two
+ */
+struct xml_node_index {
+	struct {
+		struct xml_node_index_slot* elements;
+		size_t capacity;
+	} slots;
+	size_t* positions;
+};
+
 /**
  * [OPAQUE API]
  *
  * An xml_attribute may contain text content.
  */
 struct xml_attribute {
-	struct xml_string* name;
-	struct xml_string* content;
+	struct xml_symbol* name;
+	struct xml_string content;
 };
 
 /**
  * [OPAQUE API]
  *
- * An xml_node will always contain a tag name, a 0-terminated list of attributes
- * and a 0-terminated list of children. Moreover it may contain text content.
+ * An xml_node will always contain a tag name, a list of attributes and a list
+ * of children. Moreover it may contain text content.
+ *
+ * Nodes are laid out compactly: text content is stored inline (its buffer is 0
+ * if the node has none) and the attributes are immediately followed by the
+ * child pointers in a single allocation, see xml_node_child_array.
+ *
+ * Nodes of lazily parsed documents are lazy until first accessed, `content'
+ * then holds the element's markup instead of its text, see xml_node_lazy.
+ *
+ * `source' is the element's markup from its opening tag up to and including
+ * its closing tag, which is written as is unless the node or one of its
+ * descendants has been modified. Which nodes have been modified is kept in
+ * the document's `edits', so nodes carry no state besides their contents
  */
 struct xml_node {
-	struct xml_string* name;
-	struct xml_string* content;
-	struct xml_attribute** attributes;
-	struct xml_node** children;
+	struct xml_symbol* name;
+	struct xml_string content;
+	struct xml_string source;
+
+	struct xml_attribute* attributes;
+	uint32_t attributes_length;
+	uint32_t children_length;
+
+	struct xml_node_index* index;
+};
+
+/**
+ * [PRIVATE]
+ *
+ * Growable stack of pointers, used as scratch space while the elements of an
+ * array are still being collected and for the edits of a document
+ */
+struct xml_stack {
+	void** elements;
+	size_t length;
+	size_t capacity;
 };
 
 /**
  * [OPAQUE API]
  *
- * An xml_document simply contains the root node and the underlying buffer
+ * An xml_document simply contains the root node, the underlying buffer and the
+ * arena all nodes have been allocated from. If the buffer has been mapped into
+ * memory by xml_open_path, the document owns the mapping.
+ *
+ * Strings of a `decode' document hold decoded text. `edits' are the nodes
+ * whose source no longer matches them, because references have been decoded
+ * in place or a string has been modified through the API. The stack is only
+ * allocated once that happens, until then the buffer is the document's
+ * serialization. Nodes may appear more than once
  */
 struct xml_document {
 	struct {
 		uint8_t* buffer;
 		size_t length;
+		_Bool mapped;
 	} buffer;
 
+	struct xml_allocator allocator;
+	struct xml_arena arena;
+	struct xml_symbols symbols;
 	struct xml_node* root;
+
+	_Bool decode;
+	struct xml_stack edits;
+	struct xml_error error;
+};
+
+
+
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * What the parser expects next according to the grammar
+ */
+enum xml_parser_state {
+	XML_PARSER_EXPECT_ROOT,
+	XML_PARSER_EXPECT_ATTRIBUTE,	/* Attribute or end of opening tag */
+	XML_PARSER_EXPECT_CONTENT,	/* Text, child or closing tag */
+	XML_PARSER_EXPECT_CHILD,	/* Another child or closing tag */
+	XML_PARSER_EXPECT_CLOSE,	/* Closing tag after text content */
+	XML_PARSER_DONE,
+};
+
+
+
+/**
+ * [OPAQUE API]
+ *
+ * An xml_reader drives the lexer through a document and reports tokens to its
+ * callbacks. The names of all open elements are copied onto a stack in order
+ * to match closing tags, since the input they reference might be gone by then.
+ * `open` contains the offset of each open element's name in `names`, both are
+ * allocated by `allocator`
+ */
+struct xml_reader {
+	struct xml_reader_callbacks callbacks;
+	void* context;
+	struct xml_allocator allocator;
+
+	enum xml_parser_state state;
+	_Bool in_tag;
+	struct xml_error error;
+
+	struct {
+		uint8_t* buffer;
+		size_t length;
+		size_t capacity;
+	} names;
+
+	struct {
+		size_t* elements;
+		size_t length;
+		size_t capacity;
+	} open;
 };
 
+/**
+ * [PRIVATE]
+ *
+ * Scanning kernels, each of them returns the first position in
+ * [position, length) matching its criteria or `length` if there is none.
+ *
+ * `depth' instead returns by how much the nesting level changes within
+ * [position, length): every `<' opens a tag, `</' closes an element and `/>'
+ * closes an empty one. Pairs are attributed to the position of their second
+ * byte, so the byte before `position' is read as well if there is one
+ */
+struct xml_scanner {
+	size_t (*byte)(uint8_t const* buffer, size_t position, size_t length, uint8_t byte);
+	size_t (*either)(uint8_t const* buffer, size_t position, size_t length, uint8_t first, uint8_t second);
+	size_t (*name_end)(uint8_t const* buffer, size_t position, size_t length);
+	size_t (*whitespace)(uint8_t const* buffer, size_t position, size_t length);
+	ptrdiff_t (*depth)(uint8_t const* buffer, size_t position, size_t length);
+};
 
+/**
+ * [PRIVATE]
+ *
+ * Lexical units of a document
+ */
+enum xml_token_type {
+	XML_TOKEN_ERROR,
+	XML_TOKEN_END,		/* End of input */
+	XML_TOKEN_TAG_OPEN,	/* `<name' */
+	XML_TOKEN_ATTRIBUTE,	/* `name="content"' */
+	XML_TOKEN_TAG_END,	/* `>' */
+	XML_TOKEN_TAG_EMPTY,	/* `/>' */
+	XML_TOKEN_TAG_CLOSE,	/* `</name>' */
+	XML_TOKEN_TEXT,		/* Text content without surrounding whitespace */
+};
 
+/**
+ * [PRIVATE]
+ *
+ * Token as read by the lexer, strings reference the parser's buffer
+ */
+struct xml_token {
+	enum xml_token_type type;
+	struct xml_string name;
+	struct xml_string content;
+	_Bool references;	/* Content contains `&' */
+};
 
+/**
+ * [PRIVATE]
+ *
+ * Element whose children are being parsed, `children' is the position of its
+ * first child on the children scratch stack
+ */
+struct xml_parser_frame {
+	struct xml_node* node;
+	size_t children;
+	size_t attributes;
+};
 
 /**
  * [PRIVATE]
  *
  * Parser context
+ *
+ * The parser reads the buffer using a single cursor. `in_tag` is set while the
+ * lexer is positioned between an opening tag's name and its end.
+ *
+ * If the buffer is `partial`, more input may follow. The lexer sets
+ * `exhausted` whenever it had to look beyond the end of the buffer, in which
+ * case the current token, starting at `token`, is incomplete. `resume`
+ * remembers how far the last unsuccessful search for a byte got, so the
+ * search can continue there once more input arrived.
+ *
+ * Children and attributes are pushed onto the scratch stacks while a node is
+ * parsed and copied into the arena once their number is known. Open elements
+ * are kept on the explicit `frames` stack, which may not grow beyond
+ * `max_depth` elements unless it is 0.
+ *
+ * A `lazy` parser only parses the outermost element, its children are skipped
+ * and left to be materialized on first access.
+ *
+ * A `decode` parser replaces entity and character references of text and
+ * attribute values in place, shortening the strings within the buffer. Nodes
+ * whose strings it decoded are pushed onto `edits`
+ *
+ * The first error is recorded in `error' unless it is 0
  */
 struct xml_parser {
 	uint8_t* buffer;
 	size_t position;
 	size_t length;
+	_Bool in_tag;
+
+	_Bool partial;
+	_Bool exhausted;
+	size_t token;
+	struct {
+		size_t position;
+		size_t searched;
+		int byte;
+	} resume;
+
+	struct xml_scanner const* scanner;
+	struct xml_error* error;
+
+	struct xml_arena* arena;
+	struct xml_symbols* symbols;
+	_Bool lazy;
+	_Bool decode;
+	struct xml_stack* edits;
+	struct xml_stack children;
+	struct {
+		struct xml_attribute* elements;
+		size_t length;
+		size_t capacity;
+	} attributes;
+
+	struct {
+		struct xml_parser_frame* elements;
+		size_t length;
+		size_t capacity;
+	} frames;
+	size_t max_depth;
 };
 
 /**
  * [PRIVATE]
  *
- * Character offsets
+ * Scratch stacks of a parser, kept with their capacity between documents
  */
-enum xml_parser_offset {
-	NO_CHARACTER = -1,
-	CURRENT_CHARACTER = 0,
-	NEXT_CHARACTER = 1,
+struct xml_parser_scratch {
+	struct xml_stack children;
+	struct {
+		struct xml_attribute* elements;
+		size_t capacity;
+	} attributes;
+	struct {
+		struct xml_parser_frame* elements;
+		size_t capacity;
+	} frames;
 };
 
+/**
+ * [OPAQUE API]
+ *
+ * Parser context reused across documents. The embedded `document' is the
+ * result of the latest parse, its arena, symbol table and edits as well as the
+ * parser's `scratch' stacks keep their capacity between documents
+ */
+struct xml_document_parser {
+	struct xml_options options;
+	struct xml_document document;
+	struct xml_parser_scratch scratch;
+	struct xml_pool* pool;
+};
 
+/**
+ * [OPAQUE API]
+ *
+ * Threads waiting for work. Work consists of `jobs' workers of `size' bytes
+ * each, which are passed to `function' one after the other by whichever
+ * thread claims them next, including the caller. `next' is the next worker
+ * to claim and `pending' the number of workers not finished yet, both are
+ * protected by `lock'. `run' is held by the caller whose work is running, so
+ * that callers sharing a pool take turns
+ */
+struct xml_pool {
+	struct xml_allocator allocator;
 
+	#ifdef XML_PARSER_THREADS
+	pthread_t* threads;
+	size_t length;
 
+	pthread_mutex_t run;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t idle;
+
+	void* workers;
+	size_t size;
+	size_t jobs;
+	void* (*function)(void*);
+	size_t next;
+	size_t pending;
+	_Bool stop;
+	#endif
+};
 
 /**
  * [PRIVATE]
  *
- * @return Number of attributes in 0-terminated array
+ * Character offsets
  */
-static size_t get_zero_terminated_array_attributes(struct xml_attribute** attributes) {
-	size_t elements = 0;
-
-	while (attributes[elements]) {
-		++elements;
-	}
-
-	return elements;
-}
+enum xml_parser_offset {
+	NO_CHARACTER = -1,
+	CURRENT_CHARACTER = 0,
+	NEXT_CHARACTER = 1,
+};
 
+/**
+ * [PRIVATE]
+ *
+ * Returned by xml_parser_peek at the end of the input
+ */
+#define XML_PARSER_END (-1)
 
+/**
+ * [PRIVATE]
+ *
+ * Number of xml_parser_peek calls of all threads, only available for white
+ * box tests
+ */
+#ifdef XML_PARSER_STATISTICS
+static size_t xml_parser_peeks = 0;
+#endif
 
 /**
  * [PRIVATE]
  *
- * @return Number of nodes in 0-terminated array
+ * Number of threads started by pools and of documents stolen between the
+ * workers of batches, only available for white box tests
  */
-static size_t get_zero_terminated_array_nodes(struct xml_node** nodes) {
-	size_t elements = 0;
+#ifdef XML_PARSER_STATISTICS
+static size_t xml_pool_threads_started = 0;
+static size_t xml_batch_steals = 0;
+#endif
 
-	while (nodes[elements]) {
-		++elements;
-	}
 
-	return elements;
-}
 
 
 
 /**
  * [PRIVATE]
  *
- * @warning No UTF conversions will be attempted
- *
- * @return true iff a == b
+ * Default allocator, forwarding to the `malloc' family of system calls
  */
-static _Bool xml_string_equals(struct xml_string* a, struct xml_string* b) {
-
-	if (a->length != b->length) {
-		return false;
-	}
+static void* xml_allocator_malloc(void* context, size_t size) {
+	(void)context;
+	return malloc(size);
+}
 
-	size_t i = 0; for (; i < a->length; ++i) {
-		if (a->buffer[i] != b->buffer[i]) {
-			return false;
-		}
-	}
+static void* xml_allocator_realloc(void* context, void* memory, size_t size) {
+	(void)context;
+	return realloc(memory, size);
+}
 
-	return true;
+static void xml_allocator_free(void* context, void* memory) {
+	(void)context;
+	free(memory);
 }
 
+static struct xml_allocator const xml_allocator_default = {
+	.alloc = xml_allocator_malloc,
+	.realloc = xml_allocator_realloc,
+	.free = xml_allocator_free,
+	.context = 0
+};
+
 
 
 /**
  * [PRIVATE]
+ *
+ * @return The allocator specified by `options' or the default one
  */
-static uint8_t* xml_string_clone(struct xml_string* s) {
-	if (!s) {
-		return 0;
+static struct xml_allocator xml_allocator_select(struct xml_options const* options) {
+	if (options && options->allocator) {
+		return *options->allocator;
 	}
-
-	uint8_t* clone = calloc(s->length + 1, sizeof(uint8_t));
-
-	xml_string_copy(s, clone, s->length);
-	clone[s->length] = 0;
-
-	return clone;
+	return xml_allocator_default;
 }
 
 
@@ -238,13 +651,11 @@ static uint8_t* xml_string_clone(struct xml_string* s) {
 /**
  * [PRIVATE]
  *
- * Frees the resources allocated by the string
- *
- * @warning `buffer` must _not_ be freed, since it is a reference to the
- *     document's buffer
+ * @return `size' bytes of uninitialized memory or 0 if the allocator is out of
+ *     memory
  */
-static void xml_string_free(struct xml_string* string) {
-	free(string);
+static inline void* xml_alloc(struct xml_allocator const* allocator, size_t size) {
+	return allocator->alloc(allocator->context, size ? size : 1);
 }
 
 
@@ -252,45 +663,26 @@ static void xml_string_free(struct xml_string* string) {
 /**
  * [PRIVATE]
  *
- * Frees the resources allocated by the attribute
+ * Like the `realloc' system call, `memory' may be 0
  */
-static void xml_attribute_free(struct xml_attribute* attribute) {
-	if(attribute->name) {
-		xml_string_free(attribute->name);
-	}
-	if(attribute->content) {
-		xml_string_free(attribute->content);
+static inline void* xml_realloc(struct xml_allocator const* allocator, void* memory, size_t size) {
+	if (!memory) {
+		return xml_alloc(allocator, size);
 	}
-	free(attribute);
+	return allocator->realloc(allocator->context, memory, size ? size : 1);
 }
 
+
+
 /**
  * [PRIVATE]
- * 
- * Frees the resources allocated by the node
+ *
+ * Like the `free' system call, `memory' may be 0
  */
-static void xml_node_free(struct xml_node* node) {
-	xml_string_free(node->name);
-
-	if (node->content) {
-		xml_string_free(node->content);
-	}
-
-	struct xml_attribute** at = node->attributes;
-	while(*at) {
-		xml_attribute_free(*at);
-		++at;
-	}
-	free(node->attributes);
-
-	struct xml_node** it = node->children;
-	while (*it) {
-		xml_node_free(*it);
-		++it;
+static inline void xml_free(struct xml_allocator const* allocator, void* memory) {
+	if (memory) {
+		allocator->free(allocator->context, memory);
 	}
-	free(node->children);
-
-	free(node);
 }
 
 
@@ -298,51 +690,58 @@ static void xml_node_free(struct xml_node* node) {
 /**
  * [PRIVATE]
  *
- * Echos the parsers call stack for debugging purposes
+ * Prepares an empty arena, the first block will be sized according to the
+ * expected amount of allocations
  */
-#ifdef XML_PARSER_VERBOSE
-static void xml_parser_info(struct xml_parser* parser, char const* message) {
-	fprintf(stdout, "xml_parser_info %s\n", message);
+static void xml_arena_init(struct xml_arena* arena, struct xml_allocator const* allocator, size_t size_hint) {
+	arena->allocator = allocator;
+	arena->blocks = 0;
+	arena->block_size = XML_ARENA_MINIMUM_BLOCK_SIZE;
+	arena->used = 0;
+
+	while (arena->block_size < size_hint && arena->block_size < XML_ARENA_MAXIMUM_INITIAL_BLOCK_SIZE) {
+		arena->block_size *= 2;
+	}
 }
-#else
-#define xml_parser_info(parser, message) {}
-#endif
 
 
 
 /**
  * [PRIVATE]
  *
- * Echos an error regarding the parser's source to the console
+ * @return `size` bytes of uninitialized memory owned by the arena or 0 if the
+ *     system is out of memory
  */
-static void xml_parser_error(struct xml_parser* parser, enum xml_parser_offset offset, char const* message) {
-	int row = 0;
-	int column = 0;
+static void* xml_arena_alloc(struct xml_arena* arena, size_t size) {
+	size = (size + XML_ARENA_ALIGNMENT - 1) & ~(XML_ARENA_ALIGNMENT - 1);
 
-	#define min(X,Y) ((X) < (Y) ? (X) : (Y))
-	#define max(X,Y) ((X) > (Y) ? (X) : (Y))
-	size_t character = max(0, min(parser->length, parser->position + offset));
-	#undef min
-	#undef max
+	struct xml_arena_block* block = arena->blocks;
 
-	size_t position = 0; for (; position < character; ++position) {
-		column++;
-
-		if ('\n' == parser->buffer[position]) {
-			row++;
-			column = 0;
+	/* Current block exhausted, allocate a new one which is at least twice as
+	 * large as the previous one
+	 */
+	if (!block || (block->capacity - block->used < size)) {
+		size_t capacity = arena->block_size;
+		if (capacity < size) {
+			capacity = size;
 		}
-	}
 
-	if (NO_CHARACTER != offset) {
-		fprintf(stderr,	"xml_parser_error at %i:%i (is %c): %s\n",
-				row + 1, column, parser->buffer[character], message
-		);
-	} else {
-		fprintf(stderr,	"xml_parser_error at %i:%i: %s\n",
-				row + 1, column, message
-		);
+		block = xml_alloc(arena->allocator, sizeof(struct xml_arena_block) + capacity);
+		if (!block) {
+			return 0;
+		}
+		block->next = arena->blocks;
+		block->capacity = capacity;
+		block->used = 0;
+
+		arena->blocks = block;
+		arena->block_size *= 2;
 	}
+
+	void* memory = (uint8_t*)block->data + block->used;
+	block->used += size;
+	arena->used += size;
+	return memory;
 }
 
 
@@ -350,25 +749,30 @@ static void xml_parser_error(struct xml_parser* parser, enum xml_parser_offset o
 /**
  * [PRIVATE]
  *
- * Returns the n-th not-whitespace byte in parser and 0 if such a byte does not
- * exist
+ * Moves all blocks of `source' into `arena', allocations of both stay valid
+ * and will be released together
  */
-static uint8_t xml_parser_peek(struct xml_parser* parser, size_t n) {
-	size_t position = parser->position;
-
-	while (position < parser->length) {
-		if (!isspace(parser->buffer[position])) {
-			if (n == 0) {
-				return parser->buffer[position];
-			} else {
-				--n;
-			}
-		}
+static void xml_arena_merge(struct xml_arena* arena, struct xml_arena* source) {
+	struct xml_arena_block* last = source->blocks;
+	if (!last) {
+		return;
+	}
+	while (last->next) {
+		last = last->next;
+	}
 
-		position++;
+	/* Keep allocating from the current block of `arena'
+	 */
+	if (arena->blocks) {
+		last->next = arena->blocks->next;
+		arena->blocks->next = source->blocks;
+	} else {
+		arena->blocks = source->blocks;
 	}
+	arena->used += source->used;
 
-	return 0;
+	source->blocks = 0;
+	source->used = 0;
 }
 
 
@@ -376,39 +780,51 @@ static uint8_t xml_parser_peek(struct xml_parser* parser, size_t n) {
 /**
  * [PRIVATE]
  *
- * Moves the parser's position n bytes. If the new position would be out of
- * bounds, it will be converted to the bounds itself
+ * Releases all blocks of the arena, invalidating every allocation made
  */
-static void xml_parser_consume(struct xml_parser* parser, size_t n) {
+static void xml_arena_free(struct xml_arena* arena) {
+	struct xml_arena_block* block = arena->blocks;
 
-	/* Debug information
-	 */
-	#ifdef XML_PARSER_VERBOSE
-	#define min(X,Y) ((X) < (Y) ? (X) : (Y))
-	char* consumed = alloca((n + 1) * sizeof(char));
-	memcpy(consumed, &parser->buffer[parser->position], min(n, parser->length - parser->position));
-	consumed[n] = 0;
-	#undef min
+	while (block) {
+		struct xml_arena_block* next = block->next;
+		xml_free(arena->allocator, block);
+		block = next;
+	}
+	arena->blocks = 0;
+}
 
-	size_t message_buffer_length = 512;
-	char* message_buffer = alloca(512 * sizeof(char));
-	snprintf(message_buffer, message_buffer_length, "Consuming %li bytes \"%s\"", (long)n, consumed);
-	message_buffer[message_buffer_length - 1] = 0;
 
-	xml_parser_info(parser, message_buffer);
-	#endif
 
+/**
+ * [PRIVATE]
+ *
+ * Invalidates every allocation made but keeps the memory for reuse. Several
+ * blocks are replaced by a single one of their combined capacity, so an equally
+ * large document afterwards fits into one block without further allocations.
+ * Should that block not be available, the arena is left empty
+ */
+static void xml_arena_reset(struct xml_arena* arena) {
+	struct xml_arena_block* block = arena->blocks;
+	arena->used = 0;
+
+	if (block && block->next) {
+		size_t capacity = 0;
+		for (; block; block = block->next) {
+			capacity += block->capacity;
+		}
+		xml_arena_free(arena);
 
-	/* Move the position forward
-	 */
-	parser->position += n;
+		block = xml_alloc(arena->allocator, sizeof(struct xml_arena_block) + capacity);
+		if (!block) {
+			return;
+		}
+		block->next = 0;
+		block->capacity = capacity;
+		arena->blocks = block;
+	}
 
-	/* Don't go too far
-	 *
-	 * @warning Valid because parser->length must be greater than 0
-	 */
-	if (parser->position >= parser->length) {
-		parser->position = parser->length - 1;
+	if (block) {
+		block->used = 0;
 	}
 }
 
@@ -416,19 +832,25 @@ static void xml_parser_consume(struct xml_parser* parser, size_t n) {
 
 /**
  * [PRIVATE]
- * 
- * Skips to the next non-whitespace character
+ *
+ * Appends an element to the stack, growing it geometrically
+ *
+ * @return false iff the system is out of memory
  */
-static void xml_skip_whitespace(struct xml_parser* parser) {
-	xml_parser_info(parser, "whitespace");
+static _Bool xml_stack_push(struct xml_allocator const* allocator, struct xml_stack* stack, void* element) {
+	if (stack->length == stack->capacity) {
+		size_t capacity = stack->capacity ? 2 * stack->capacity : 16;
+		void** elements = xml_realloc(allocator, stack->elements, capacity * sizeof(void*));
 
-	while (isspace(parser->buffer[parser->position])) {
-		if (parser->position + 1 >= parser->length) {
-			return;
-		} else {
-			parser->position++;
+		if (!elements) {
+			return false;
 		}
+		stack->elements = elements;
+		stack->capacity = capacity;
 	}
+
+	stack->elements[stack->length++] = element;
+	return true;
 }
 
 
@@ -436,75 +858,83 @@ static void xml_skip_whitespace(struct xml_parser* parser) {
 /**
  * [PRIVATE]
  *
- * Finds and creates all attributes on the given node.
+ * Records that `node' no longer matches its source. Consecutive modifications
+ * of the same node are only recorded once
  *
- * @author Blake Felt
- * @see https://github.com/Molorius
+ * @return false iff the system is out of memory
  */
-static struct xml_attribute** xml_find_attributes(struct xml_parser* parser, struct xml_string* tag_open) {
-	xml_parser_info(parser, "find_attributes");
-	char* tmp;
-	char* rest = NULL;
-	char* token;
-	char* str_name;
-	char* str_content;
-	const unsigned char* start_name;
-	const unsigned char* start_content;
-	size_t old_elements;
-	size_t new_elements;
-	struct xml_attribute* new_attribute;
-	struct xml_attribute** attributes;
-	int position;
+static _Bool xml_edits_push(struct xml_allocator const* allocator, struct xml_stack* edits, struct xml_node* node) {
+	if (edits->length && (node == edits->elements[edits->length - 1])) {
+		return true;
+	}
+	return xml_stack_push(allocator, edits, node);
+}
 
-	attributes = calloc(1, sizeof(struct xml_attribute*));
-	attributes[0] = 0;
 
-	tmp = (char*) xml_string_clone(tag_open);
 
-	token = xml_strtok_r(tmp, " ", &rest); // skip the first value
-	if(token == NULL) {
-		goto cleanup;
+/**
+ * [PRIVATE]
+ *
+ * Grows `array' of `capacity' elements of `size' bytes to hold at least
+ * `required' more elements than `length'. Capacity grows geometrically
+ *
+ * @return false iff the system is out of memory
+ */
+static _Bool xml_array_reserve(struct xml_allocator const* allocator, void** array, size_t* capacity, size_t length, size_t required, size_t size) {
+	if (length + required <= *capacity) {
+		return true;
+	}
+
+	size_t grown = *capacity ? 2 * *capacity : 64;
+	while (grown < length + required) {
+		grown *= 2;
 	}
-	tag_open->length = strlen(token);
 
-	for(token=xml_strtok_r(NULL," ", &rest); token!=NULL; token=xml_strtok_r(NULL," ", &rest)) {
-		str_name = malloc(strlen(token)+1);
-		str_content = malloc(strlen(token)+1);
-		// %s=\"%s\" wasn't working for some reason, ugly hack to make it work
-		if(sscanf(token, "%[^=]=\"%[^\"]", str_name, str_content) != 2) {
-			if(sscanf(token, "%[^=]=\'%[^\']", str_name, str_content) != 2) {
-				free(str_name);
-				free(str_content);
-				continue;
-			}
-		}
-		position = token-tmp;
-		start_name = &tag_open->buffer[position];
-		start_content = &tag_open->buffer[position + strlen(str_name) + 2];
+	void* elements = xml_realloc(allocator, *array, grown * size);
+	if (!elements) {
+		return false;
+	}
+	*array = elements;
+	*capacity = grown;
+	return true;
+}
 
-		new_attribute = malloc(sizeof(struct xml_attribute));
-		new_attribute->name = malloc(sizeof(struct xml_string));
-		new_attribute->name->buffer = (unsigned char*)start_name;
-		new_attribute->name->length = strlen(str_name);
-		new_attribute->content = malloc(sizeof(struct xml_string));
-		new_attribute->content->buffer = (unsigned char*)start_content;
-		new_attribute->content->length = strlen(str_content);
 
-		old_elements = get_zero_terminated_array_attributes(attributes);
-		new_elements = old_elements + 1;
-		attributes = realloc(attributes, (new_elements+1)*sizeof(struct xml_attribute*));
 
-		attributes[new_elements-1] = new_attribute;
-		attributes[new_elements] = 0;
+/**
+ * [PRIVATE]
+ *
+ * @warning No UTF conversions will be attempted
+ *
+ * @return true iff a == b
+ */
+static _Bool xml_string_equals(struct xml_string* a, struct xml_string* b) {
 
+	if (a->length != b->length) {
+		return false;
+	}
 
-		free(str_name);
-		free(str_content);
+	size_t i = 0; for (; i < a->length; ++i) {
+		if (a->buffer[i] != b->buffer[i]) {
+			return false;
+		}
 	}
 
-cleanup:
-	free(tmp);
-	return attributes;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ */
+static void xml_symbols_init(struct xml_symbols* symbols, struct xml_arena* arena) {
+	symbols->arena = arena;
+	symbols->slots.elements = 0;
+	symbols->slots.capacity = 0;
+	symbols->symbols.elements = 0;
+	symbols->symbols.length = 0;
+	symbols->symbols.capacity = 0;
 }
 
 
@@ -512,44 +942,52 @@ cleanup:
 /**
  * [PRIVATE]
  *
- * Parses the name out of the an XML tag's ending
+ * FNV-1a, names are short enough for a bytewise hash
+ */
+static uint32_t xml_symbols_hash(uint8_t const* buffer, size_t length) {
+	uint32_t hash = 2166136261u;
+
+	size_t i = 0; for (; i < length; ++i) {
+		hash = (hash ^ buffer[i]) * 16777619u;
+	}
+	return hash;
+}
+
+
+
+/**
+ * [PRIVATE]
  *
- * ---( Example )---
- * tag_name>
- * ---
+ * @return Slot containing the symbol or the empty slot it would be stored in
+ * @warning Table must have been allocated
  */
-static struct xml_string* xml_parse_tag_end(struct xml_parser* parser) {
-	xml_parser_info(parser, "tag_end");
-	size_t start = parser->position;
-	size_t length = 0;
+static struct xml_symbol** xml_symbols_slot(struct xml_symbols* symbols, uint8_t const* buffer, size_t length, uint32_t hash) {
+	size_t mask = symbols->slots.capacity - 1;
+	size_t slot = hash & mask;
 
-	/* Parse until `>' or a whitespace is reached
-	 */
-	while (start + length < parser->length) {
-		uint8_t current = xml_parser_peek(parser, CURRENT_CHARACTER);
+	for (;; slot = (slot + 1) & mask) {
+		struct xml_symbol* symbol = symbols->slots.elements[slot];
 
-		if (('>' == current) || isspace(current)) {
-			break;
-		} else {
-			xml_parser_consume(parser, 1);
-			length++;
+		if (!symbol || (		(symbol->hash == hash)
+					&&	(symbol->name.length == length)
+					&&	!memcmp(symbol->name.buffer, buffer, length))) {
+			return &symbols->slots.elements[slot];
 		}
 	}
+}
 
-	/* Consume `>'
-	 */
-	if ('>' != xml_parser_peek(parser, CURRENT_CHARACTER)) {
-		xml_parser_error(parser, CURRENT_CHARACTER, "xml_parse_tag_end::expected tag end");
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return The symbol of the name or 0 if the document does not contain it
+ */
+static struct xml_symbol* xml_symbols_lookup(struct xml_symbols* symbols, uint8_t const* buffer, size_t length) {
+	if (!symbols->slots.capacity) {
 		return 0;
 	}
-	xml_parser_consume(parser, 1);
-
-	/* Return parsed tag name
-	 */
-	struct xml_string* name = malloc(sizeof(struct xml_string));
-	name->buffer = &parser->buffer[start];
-	name->length = length;
-	return name;
+	return *xml_symbols_slot(symbols, buffer, length, xml_symbols_hash(buffer, length));
 }
 
 
@@ -557,27 +995,71 @@ static struct xml_string* xml_parse_tag_end(struct xml_parser* parser) {
 /**
  * [PRIVATE]
  *
- * Parses an opening XML tag without attributes
+ * Doubles the hash table and reinserts all symbols
+ */
+static _Bool xml_symbols_grow(struct xml_symbols* symbols) {
+	size_t capacity = symbols->slots.capacity ? 2 * symbols->slots.capacity : 64;
+
+	struct xml_symbol** elements = xml_alloc(symbols->arena->allocator, capacity * sizeof(struct xml_symbol*));
+	if (!elements) {
+		return false;
+	}
+	memset(elements, 0, capacity * sizeof(struct xml_symbol*));
+	xml_free(symbols->arena->allocator, symbols->slots.elements);
+	symbols->slots.elements = elements;
+	symbols->slots.capacity = capacity;
+
+	size_t i = 0; for (; i < symbols->symbols.length; ++i) {
+		struct xml_symbol* symbol = symbols->symbols.elements[i];
+		*xml_symbols_slot(symbols, symbol->name.buffer, symbol->name.length, symbol->hash) = symbol;
+	}
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
  *
- * ---( Example )---
- * <tag_name>
- * ---
+ * @return Symbol shared by all occurrences of `name', 0 iff the system is out
+ *     of memory
  */
-static struct xml_string* xml_parse_tag_open(struct xml_parser* parser) {
-	xml_parser_info(parser, "tag_open");
-	xml_skip_whitespace(parser);
+static struct xml_symbol* xml_symbols_intern(struct xml_symbols* symbols, struct xml_string* name) {
+	uint32_t hash = xml_symbols_hash(name->buffer, name->length);
 
-	/* Consume `<'
+	/* Keep load factor below one half
 	 */
-	if ('<' != xml_parser_peek(parser, CURRENT_CHARACTER)) {
-		xml_parser_error(parser, CURRENT_CHARACTER, "xml_parse_tag_open::expected opening tag");
-		return 0;
+	if (2 * (symbols->symbols.length + 1) > symbols->slots.capacity) {
+		if (!xml_symbols_grow(symbols)) {
+			return 0;
+		}
+	}
+
+	struct xml_symbol** slot = xml_symbols_slot(symbols, name->buffer, name->length, hash);
+	if (*slot) {
+		return *slot;
 	}
-	xml_parser_consume(parser, 1);
 
-	/* Consume tag name
+	/* First occurrence of this name
 	 */
-	return xml_parse_tag_end(parser);
+	if (		(symbols->symbols.length >= UINT32_MAX)
+		||	!xml_array_reserve(symbols->arena->allocator, (void**)&symbols->symbols.elements, &symbols->symbols.capacity, symbols->symbols.length, 1, sizeof(struct xml_symbol*))) {
+		return 0;
+	}
+
+	struct xml_symbol* symbol = xml_arena_alloc(symbols->arena, sizeof(struct xml_symbol));
+	if (!symbol) {
+		return 0;
+	}
+	symbol->name = *name;
+	symbol->id = (uint32_t)(symbols->symbols.length + 1);
+	symbol->hash = hash;
+	symbol->symbols = symbols;
+	symbol->forward = symbol;
+
+	symbols->symbols.elements[symbols->symbols.length++] = symbol;
+	*slot = symbol;
+	return symbol;
 }
 
 
@@ -585,35 +1067,45 @@ static struct xml_string* xml_parse_tag_open(struct xml_parser* parser) {
 /**
  * [PRIVATE]
  *
- * Parses an closing XML tag without attributes
+ * Moves a symbol of another table into `symbols' unless the name is already
+ * known, `forward' of the symbol will point to the symbol to use from now on
  *
- * ---( Example )---
- * </tag_name>
- * ---
+ * @return false iff the system is out of memory
  */
-static struct xml_string* xml_parse_tag_close(struct xml_parser* parser) {
-	xml_parser_info(parser, "tag_close");
-	xml_skip_whitespace(parser);
-
-	/* Consume `</'
-	 */
-	if (		('<' != xml_parser_peek(parser, CURRENT_CHARACTER))
-		||	('/' != xml_parser_peek(parser, NEXT_CHARACTER))) {
-
-		if ('<' != xml_parser_peek(parser, CURRENT_CHARACTER)) {
-			xml_parser_error(parser, CURRENT_CHARACTER, "xml_parse_tag_close::expected closing tag `<'");
-		}
-		if ('/' != xml_parser_peek(parser, NEXT_CHARACTER)) {
-			xml_parser_error(parser, NEXT_CHARACTER, "xml_parse_tag_close::expected closing tag `/'");
+static _Bool xml_symbols_adopt(struct xml_symbols* symbols, struct xml_symbol* symbol) {
+	if (2 * (symbols->symbols.length + 1) > symbols->slots.capacity) {
+		if (!xml_symbols_grow(symbols)) {
+			return false;
 		}
+	}
 
-		return 0;
+	struct xml_symbol** slot = xml_symbols_slot(symbols, symbol->name.buffer, symbol->name.length, symbol->hash);
+	if (*slot) {
+		symbol->forward = *slot;
+		return true;
 	}
-	xml_parser_consume(parser, 2);
 
-	/* Consume tag name
-	 */
-	return xml_parse_tag_end(parser);
+	if (		(symbols->symbols.length >= UINT32_MAX)
+		||	!xml_array_reserve(symbols->arena->allocator, (void**)&symbols->symbols.elements, &symbols->symbols.capacity, symbols->symbols.length, 1, sizeof(struct xml_symbol*))) {
+		return false;
+	}
+	symbol->id = (uint32_t)(symbols->symbols.length + 1);
+	symbol->symbols = symbols;
+	symbol->forward = symbol;
+
+	symbols->symbols.elements[symbols->symbols.length++] = symbol;
+	*slot = symbol;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ */
+static void xml_symbols_free(struct xml_symbols* symbols) {
+	xml_free(symbols->arena->allocator, symbols->slots.elements);
+	xml_free(symbols->arena->allocator, symbols->symbols.elements);
 }
 
 
@@ -621,242 +1113,4721 @@ static struct xml_string* xml_parse_tag_close(struct xml_parser* parser) {
 /**
  * [PRIVATE]
  *
- * Parses a tag's content
+ * Forgets all symbols, which have been allocated from the arena, but keeps the
+ * capacity of both tables
+ */
+static void xml_symbols_reset(struct xml_symbols* symbols) {
+	if (symbols->slots.capacity) {
+		memset(symbols->slots.elements, 0, symbols->slots.capacity * sizeof(struct xml_symbol*));
+	}
+	symbols->symbols.length = 0;
+}
+
+
+
+/**
+ * [PRIVATE]
  *
- * ---( Example )---
- *     this is
- *   a
- *       tag {} content
- * ---
+ * @return Pointers to the node's children, stored right behind its attributes
+ */
+static inline struct xml_node** xml_node_child_array(struct xml_node* node) {
+	return (struct xml_node**)(node->attributes + node->attributes_length);
+}
+
+
+
+/**
+ * [PRIVATE]
  *
- * @warning CDATA etc. is _not_ and will never be supported
+ * Builds the child index of `node' in four passes over its children: reset
+ * the scratch fields of their names, count the children of each name, assign
+ * every name its range of positions and fill the ranges
+ *
+ * @return The node's index or 0 if the system is out of memory
  */
-static struct xml_string* xml_parse_content(struct xml_parser* parser) {
-	xml_parser_info(parser, "content");
+static struct xml_node_index* xml_node_index_build(struct xml_node* node) {
+	struct xml_arena* arena = node->name->symbols->arena;
+	struct xml_node** children = xml_node_child_array(node);
+	size_t distinct = 0;
+
+	size_t i = 0; for (; i < node->children_length; ++i) {
+		struct xml_symbol* name = children[i]->name;
+		name->scratch.children = 0;
+		name->scratch.slot = 0;
+	}
+	for (i = 0; i < node->children_length; ++i) {
+		if (!children[i]->name->scratch.children++) {
+			distinct++;
+		}
+	}
 
-	/* Whitespace will be ignored
+	/* Keep load factor below one half
 	 */
-	xml_skip_whitespace(parser);
+	size_t capacity = 1;
+	while (capacity < 2 * distinct) {
+		capacity *= 2;
+	}
 
-	size_t start = parser->position;
-	size_t length = 0;
+	struct xml_node_index* index = xml_arena_alloc(arena, sizeof(struct xml_node_index));
+	if (!index) {
+		return 0;
+	}
+	index->slots.elements = xml_arena_alloc(arena, capacity * sizeof(struct xml_node_index_slot));
+	index->slots.capacity = capacity;
+	index->positions = xml_arena_alloc(arena, node->children_length * sizeof(size_t));
 
-	/* Consume until `<' is reached
+	if (!index->slots.elements || !index->positions) {
+		return 0;
+	}
+	memset(index->slots.elements, 0, capacity * sizeof(struct xml_node_index_slot));
+
+	/* Names get consecutive ranges in order of their first occurrence
 	 */
-	while (start + length < parser->length) {
-		uint8_t current = xml_parser_peek(parser, CURRENT_CHARACTER);
+	size_t offset = 0;
+	for (i = 0; i < node->children_length; ++i) {
+		struct xml_symbol* name = children[i]->name;
+		if (name->scratch.slot) {
+			continue;
+		}
 
-		if ('<' == current) {
-			break;
-		} else {
-			xml_parser_consume(parser, 1);
-			length++;
+		size_t slot = name->hash & (capacity - 1);
+		while (index->slots.elements[slot].name) {
+			slot = (slot + 1) & (capacity - 1);
 		}
+
+		name->scratch.slot = &index->slots.elements[slot];
+		name->scratch.slot->name = name;
+		name->scratch.slot->offset = offset;
+		offset += name->scratch.children;
 	}
 
-	/* Next character must be an `<' or we have reached end of file
-	 */
-	if ('<' != xml_parser_peek(parser, CURRENT_CHARACTER)) {
-		xml_parser_error(parser, CURRENT_CHARACTER, "xml_parse_content::expected <");
-		return 0;
+	for (i = 0; i < node->children_length; ++i) {
+		struct xml_node_index_slot* slot = children[i]->name->scratch.slot;
+		index->positions[slot->offset + slot->length++] = i;
 	}
 
-	/* Ignore tailing whitespace
-	 */
-	while ((length > 0) && isspace(parser->buffer[start + length - 1])) {
-		length--;
+	return index;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return The slot of all children named `name' or 0 if there is none
+ */
+static struct xml_node_index_slot* xml_node_index_find(struct xml_node_index* index, struct xml_symbol* name) {
+	size_t mask = index->slots.capacity - 1;
+	size_t slot = name->hash & mask;
+
+	for (;; slot = (slot + 1) & mask) {
+		struct xml_node_index_slot* candidate = &index->slots.elements[slot];
+
+		if (candidate->name == name) {
+			return candidate;
+		}
+		if (!candidate->name) {
+			return 0;
+		}
+	}
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return The node's child index, 0 if the node has too few children to
+ *     benefit from an index or the index could not be built
+ */
+static struct xml_node_index* xml_node_index(struct xml_node* node) {
+	if (!node->index && (node->children_length >= XML_NODE_INDEX_MINIMUM_CHILDREN)) {
+		node->index = xml_node_index_build(node);
 	}
+	return node->index;
+}
 
-	/* Return text
-	 */
-	struct xml_string* content = malloc(sizeof(struct xml_string));
-	content->buffer = &parser->buffer[start];
-	content->length = length;
-	return content;
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return 0-terminated copy of `s` allocated by `calloc` or 0 if `s` is 0 or
+ *     no memory is available
+ */
+static uint8_t* xml_string_clone(struct xml_string* s) {
+	if (!s) {
+		return 0;
+	}
+
+	uint8_t* clone = calloc(s->length + 1, sizeof(uint8_t));
+	if (!clone) {
+		return 0;
+	}
+
+	xml_string_copy(s, clone, s->length);
+	clone[s->length] = 0;
+
+	return clone;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Character classes of all bytes, XML only knows four whitespace characters
+ * and does not depend on the locale
+ */
+#define XML_WHITESPACE 1
+#define XML_NAME_END 2
+
+static uint8_t const xml_character_class[256] = {
+	['\t'] = XML_WHITESPACE | XML_NAME_END,
+	['\n'] = XML_WHITESPACE | XML_NAME_END,
+	['\r'] = XML_WHITESPACE | XML_NAME_END,
+	[' '] = XML_WHITESPACE | XML_NAME_END,
+	['/'] = XML_NAME_END,
+	['='] = XML_NAME_END,
+	['>'] = XML_NAME_END,
+};
+
+#define xml_is_whitespace(c) (xml_character_class[(uint8_t)(c)] & XML_WHITESPACE)
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Portable scanning kernels, one byte at a time
+ */
+static size_t xml_scan_byte_scalar(uint8_t const* buffer, size_t position, size_t length, uint8_t byte) {
+	uint8_t const* found = memchr(&buffer[position], byte, length - position);
+	return found ? (size_t)(found - buffer) : length;
+}
+
+static size_t xml_scan_either_scalar(uint8_t const* buffer, size_t position, size_t length, uint8_t first, uint8_t second) {
+	while ((position < length) && (first != buffer[position]) && (second != buffer[position])) {
+		position++;
+	}
+	return position;
+}
+
+static size_t xml_scan_name_end_scalar(uint8_t const* buffer, size_t position, size_t length) {
+	while ((position < length) && !(xml_character_class[buffer[position]] & XML_NAME_END)) {
+		position++;
+	}
+	return position;
+}
+
+static size_t xml_scan_whitespace_scalar(uint8_t const* buffer, size_t position, size_t length) {
+	while ((position < length) && xml_is_whitespace(buffer[position])) {
+		position++;
+	}
+	return position;
+}
+
+static ptrdiff_t xml_scan_depth_scalar(uint8_t const* buffer, size_t position, size_t length) {
+	ptrdiff_t depth = 0;
+	uint8_t previous = position ? buffer[position - 1] : 0;
+
+	for (; position < length; ++position) {
+		uint8_t current = buffer[position];
+
+		if ('<' == current) {
+			depth++;
+		} else if (('/' == current) && ('<' == previous)) {
+			depth -= 2;
+		} else if (('>' == current) && ('/' == previous)) {
+			depth--;
+		}
+		previous = current;
+	}
+	return depth;
+}
+
+static struct xml_scanner const xml_scanner_scalar = {
+	.byte = xml_scan_byte_scalar,
+	.either = xml_scan_either_scalar,
+	.name_end = xml_scan_name_end_scalar,
+	.whitespace = xml_scan_whitespace_scalar,
+	.depth = xml_scan_depth_scalar,
+};
+
+
+
+#ifdef XML_PARSER_X86_KERNELS
+/**
+ * [PRIVATE]
+ *
+ * SSE2 scanning kernels, 16 bytes at a time
+ */
+__attribute__((target("sse2")))
+static inline int xml_sse2_whitespace_mask(__m128i chunk) {
+	__m128i whitespace = _mm_or_si128(
+		_mm_or_si128(
+			_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+			_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))
+		),
+		_mm_or_si128(
+			_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')),
+			_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))
+		)
+	);
+	return _mm_movemask_epi8(whitespace);
+}
+
+__attribute__((target("sse2")))
+static size_t xml_scan_byte_sse2(uint8_t const* buffer, size_t position, size_t length, uint8_t byte) {
+	__m128i needle = _mm_set1_epi8((char)byte);
+
+	for (; position + 16 <= length; position += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const*)&buffer[position]);
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_byte_scalar(buffer, position, length, byte);
+}
+
+__attribute__((target("sse2")))
+static size_t xml_scan_either_sse2(uint8_t const* buffer, size_t position, size_t length, uint8_t first, uint8_t second) {
+	__m128i needle_first = _mm_set1_epi8((char)first);
+	__m128i needle_second = _mm_set1_epi8((char)second);
+
+	for (; position + 16 <= length; position += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const*)&buffer[position]);
+		int mask = _mm_movemask_epi8(_mm_or_si128(
+			_mm_cmpeq_epi8(chunk, needle_first),
+			_mm_cmpeq_epi8(chunk, needle_second)
+		));
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_either_scalar(buffer, position, length, first, second);
+}
+
+__attribute__((target("sse2")))
+static size_t xml_scan_name_end_sse2(uint8_t const* buffer, size_t position, size_t length) {
+	for (; position + 16 <= length; position += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const*)&buffer[position]);
+		__m128i markup = _mm_or_si128(
+			_mm_cmpeq_epi8(chunk, _mm_set1_epi8('/')),
+			_mm_or_si128(
+				_mm_cmpeq_epi8(chunk, _mm_set1_epi8('=')),
+				_mm_cmpeq_epi8(chunk, _mm_set1_epi8('>'))
+			)
+		);
+		int mask = _mm_movemask_epi8(markup) | xml_sse2_whitespace_mask(chunk);
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_name_end_scalar(buffer, position, length);
+}
+
+__attribute__((target("sse2")))
+static size_t xml_scan_whitespace_sse2(uint8_t const* buffer, size_t position, size_t length) {
+	for (; position + 16 <= length; position += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const*)&buffer[position]);
+		int mask = ~xml_sse2_whitespace_mask(chunk) & 0xFFFF;
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_whitespace_scalar(buffer, position, length);
+}
+
+/* Bit masks of `<' and `/' are shifted by one byte to find the pairs, their
+ * last bit is carried over to the next chunk
+ */
+__attribute__((target("sse2")))
+static ptrdiff_t xml_scan_depth_sse2(uint8_t const* buffer, size_t position, size_t length) {
+	ptrdiff_t depth = 0;
+	int opening = (position && ('<' == buffer[position - 1])) ? 1 : 0;
+	int slash = (position && ('/' == buffer[position - 1])) ? 1 : 0;
+
+	for (; position + 16 <= length; position += 16) {
+		__m128i chunk = _mm_loadu_si128((__m128i const*)&buffer[position]);
+		int tags = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('<')));
+		int slashes = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('/')));
+		int ends = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('>')));
+
+		int closing = slashes & ((tags << 1) | opening);
+		int empty = ends & ((slashes << 1) | slash);
+
+		depth += __builtin_popcount(tags) - 2 * __builtin_popcount(closing) - __builtin_popcount(empty);
+		opening = (tags >> 15) & 1;
+		slash = (slashes >> 15) & 1;
+	}
+	return depth + xml_scan_depth_scalar(buffer, position, length);
+}
+
+static struct xml_scanner const xml_scanner_sse2 = {
+	.byte = xml_scan_byte_sse2,
+	.either = xml_scan_either_sse2,
+	.name_end = xml_scan_name_end_sse2,
+	.whitespace = xml_scan_whitespace_sse2,
+	.depth = xml_scan_depth_sse2,
+};
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * AVX2 scanning kernels, 32 bytes at a time. Remaining bytes are handed to
+ * the SSE2 kernels
+ */
+__attribute__((target("avx2")))
+static inline uint32_t xml_avx2_whitespace_mask(__m256i chunk) {
+	__m256i whitespace = _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')),
+			_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))
+		),
+		_mm256_or_si256(
+			_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')),
+			_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))
+		)
+	);
+	return (uint32_t)_mm256_movemask_epi8(whitespace);
+}
+
+__attribute__((target("avx2")))
+static size_t xml_scan_byte_avx2(uint8_t const* buffer, size_t position, size_t length, uint8_t byte) {
+	__m256i needle = _mm256_set1_epi8((char)byte);
+
+	for (; position + 32 <= length; position += 32) {
+		__m256i chunk = _mm256_loadu_si256((__m256i const*)&buffer[position]);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_byte_sse2(buffer, position, length, byte);
+}
+
+__attribute__((target("avx2")))
+static size_t xml_scan_either_avx2(uint8_t const* buffer, size_t position, size_t length, uint8_t first, uint8_t second) {
+	__m256i needle_first = _mm256_set1_epi8((char)first);
+	__m256i needle_second = _mm256_set1_epi8((char)second);
+
+	for (; position + 32 <= length; position += 32) {
+		__m256i chunk = _mm256_loadu_si256((__m256i const*)&buffer[position]);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_cmpeq_epi8(chunk, needle_first),
+			_mm256_cmpeq_epi8(chunk, needle_second)
+		));
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_either_sse2(buffer, position, length, first, second);
+}
+
+__attribute__((target("avx2")))
+static size_t xml_scan_name_end_avx2(uint8_t const* buffer, size_t position, size_t length) {
+	for (; position + 32 <= length; position += 32) {
+		__m256i chunk = _mm256_loadu_si256((__m256i const*)&buffer[position]);
+		__m256i markup = _mm256_or_si256(
+			_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')),
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('=')),
+				_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('>'))
+			)
+		);
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(markup) | xml_avx2_whitespace_mask(chunk);
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_name_end_sse2(buffer, position, length);
+}
+
+__attribute__((target("avx2")))
+static size_t xml_scan_whitespace_avx2(uint8_t const* buffer, size_t position, size_t length) {
+	for (; position + 32 <= length; position += 32) {
+		__m256i chunk = _mm256_loadu_si256((__m256i const*)&buffer[position]);
+		uint32_t mask = ~xml_avx2_whitespace_mask(chunk);
+
+		if (mask) {
+			return position + __builtin_ctz(mask);
+		}
+	}
+	return xml_scan_whitespace_sse2(buffer, position, length);
+}
+
+__attribute__((target("avx2,popcnt")))
+static ptrdiff_t xml_scan_depth_avx2(uint8_t const* buffer, size_t position, size_t length) {
+	ptrdiff_t depth = 0;
+	uint32_t opening = (position && ('<' == buffer[position - 1])) ? 1 : 0;
+	uint32_t slash = (position && ('/' == buffer[position - 1])) ? 1 : 0;
+
+	for (; position + 32 <= length; position += 32) {
+		__m256i chunk = _mm256_loadu_si256((__m256i const*)&buffer[position]);
+		uint32_t tags = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('<')));
+		uint32_t slashes = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('/')));
+		uint32_t ends = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('>')));
+
+		/* Text without markup is common
+		 */
+		if (!(tags | slashes | ends)) {
+			opening = 0;
+			slash = 0;
+			continue;
+		}
+
+		uint32_t closing = slashes & ((tags << 1) | opening);
+		uint32_t empty = ends & ((slashes << 1) | slash);
+
+		depth += __builtin_popcount(tags) - 2 * __builtin_popcount(closing) - __builtin_popcount(empty);
+		opening = tags >> 31;
+		slash = slashes >> 31;
+	}
+	return depth + xml_scan_depth_sse2(buffer, position, length);
+}
+
+static struct xml_scanner const xml_scanner_avx2 = {
+	.byte = xml_scan_byte_avx2,
+	.either = xml_scan_either_avx2,
+	.name_end = xml_scan_name_end_avx2,
+	.whitespace = xml_scan_whitespace_avx2,
+	.depth = xml_scan_depth_avx2,
+};
+#endif
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return Fastest scanning kernels supported by the executing CPU
+ */
+static struct xml_scanner const* xml_scanner_select() {
+	#ifdef XML_PARSER_X86_KERNELS
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return &xml_scanner_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return &xml_scanner_sse2;
+	}
+	#endif
+
+	return &xml_scanner_scalar;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Encodes a code point as UTF-8
+ *
+ * @return Number of bytes written to `character', 0 iff the code point is not
+ *     a character allowed in XML documents
+ */
+static size_t xml_encode_utf8(uint32_t code_point, uint8_t* character) {
+	if (		((code_point < 0x20) && (0x9 != code_point) && (0xA != code_point) && (0xD != code_point))
+		||	((code_point >= 0xD800) && (code_point <= 0xDFFF))
+		||	(0xFFFE == code_point) || (0xFFFF == code_point)
+		||	(code_point > 0x10FFFF)) {
+		return 0;
+	}
+
+	if (code_point < 0x80) {
+		character[0] = (uint8_t)code_point;
+		return 1;
+	}
+	if (code_point < 0x800) {
+		character[0] = (uint8_t)(0xC0 | (code_point >> 6));
+		character[1] = (uint8_t)(0x80 | (code_point & 0x3F));
+		return 2;
+	}
+	if (code_point < 0x10000) {
+		character[0] = (uint8_t)(0xE0 | (code_point >> 12));
+		character[1] = (uint8_t)(0x80 | ((code_point >> 6) & 0x3F));
+		character[2] = (uint8_t)(0x80 | (code_point & 0x3F));
+		return 3;
+	}
+	character[0] = (uint8_t)(0xF0 | (code_point >> 18));
+	character[1] = (uint8_t)(0x80 | ((code_point >> 12) & 0x3F));
+	character[2] = (uint8_t)(0x80 | ((code_point >> 6) & 0x3F));
+	character[3] = (uint8_t)(0x80 | (code_point & 0x3F));
+	return 4;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Decodes the entity or character reference starting with the `&' at
+ * `position'. Only the five predefined entities are known
+ *
+ * ---( Example )---
+ * &amp; &lt; &#169; &#x20AC;
+ * ---
+ *
+ * @return Position after the reference's `;' or 0 iff there is no valid
+ *     reference at `position'
+ */
+static size_t xml_decode_reference(uint8_t const* buffer, size_t position, size_t length, uint8_t* character, size_t* character_length) {
+	static struct {
+		char const* name;
+		size_t length;
+		uint8_t character;
+	} const entities[] = {
+		{"amp;", 4, '&'},
+		{"lt;", 3, '<'},
+		{"gt;", 3, '>'},
+		{"quot;", 5, '"'},
+		{"apos;", 5, '\''},
+	};
+	position++;
+
+	if ((position < length) && ('#' == buffer[position])) {
+		position++;
+
+		_Bool hexadecimal = (position < length) && ('x' == buffer[position]);
+		if (hexadecimal) {
+			position++;
+		}
+
+		/* Digits beyond the largest code point are consumed but ignored
+		 */
+		uint32_t code_point = 0;
+		size_t digits = 0;
+
+		for (; position < length; ++position, ++digits) {
+			uint8_t digit = buffer[position];
+			uint32_t value;
+
+			if ((digit >= '0') && (digit <= '9')) {
+				value = digit - '0';
+			} else if (hexadecimal && (digit >= 'a') && (digit <= 'f')) {
+				value = digit - 'a' + 10;
+			} else if (hexadecimal && (digit >= 'A') && (digit <= 'F')) {
+				value = digit - 'A' + 10;
+			} else {
+				break;
+			}
+
+			code_point = code_point * (hexadecimal ? 16 : 10) + value;
+			if (code_point > 0x10FFFF) {
+				code_point = 0x110000;
+			}
+		}
+
+		if (!digits || (position >= length) || (';' != buffer[position])) {
+			return 0;
+		}
+		*character_length = xml_encode_utf8(code_point, character);
+		return *character_length ? position + 1 : 0;
+	}
+
+	size_t i = 0; for (; i < sizeof(entities) / sizeof(entities[0]); ++i) {
+		if (		(length - position >= entities[i].length)
+			&&	!memcmp(&buffer[position], entities[i].name, entities[i].length)) {
+
+			character[0] = entities[i].character;
+			*character_length = 1;
+			return position + entities[i].length;
+		}
+	}
+	return 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Appends `length' bytes to the `decoded' bytes of `destination', as far as
+ * its `capacity' allows. The bytes may overlap the destination
+ */
+static inline void xml_decode_emit(uint8_t* destination, size_t capacity, size_t* decoded, uint8_t const* bytes, size_t length) {
+	size_t emitted = (*decoded < capacity) ? capacity - *decoded : 0;
+	if (length < emitted) {
+		emitted = length;
+	}
+
+	if (emitted && (&destination[*decoded] != bytes)) {
+		memmove(&destination[*decoded], bytes, emitted);
+	}
+	*decoded += length;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Decodes all references of `source' into `destination', which may be
+ * `source' itself since decoding never makes a string longer. Anything that
+ * is not a valid reference, including a lone `&', is copied unchanged.
+ * Strings without `&' are found by the scanning kernels and not touched at
+ * all
+ *
+ * @return Length of the decoded string, of which at most `capacity' bytes
+ *     are written
+ */
+static size_t xml_decode(struct xml_scanner const* scanner, uint8_t const* source, size_t length, uint8_t* destination, size_t capacity) {
+	size_t decoded = 0;
+	size_t position = 0;
+
+	while (position < length) {
+		size_t reference = scanner->byte(source, position, length, '&');
+		xml_decode_emit(destination, capacity, &decoded, &source[position], reference - position);
+
+		if (reference >= length) {
+			break;
+		}
+
+		uint8_t character[4];
+		size_t character_length = 0;
+		size_t end = xml_decode_reference(source, reference, length, character, &character_length);
+
+		if (end) {
+			xml_decode_emit(destination, capacity, &decoded, character, character_length);
+			position = end;
+		} else {
+			xml_decode_emit(destination, capacity, &decoded, &source[reference], 1);
+			position = reference + 1;
+		}
+	}
+	return decoded;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Echos the parsers call stack for debugging purposes
+ */
+#ifdef XML_PARSER_VERBOSE
+static void xml_parser_info(struct xml_parser* parser, char const* message) {
+	fprintf(stdout, "xml_parser_info %s\n", message);
+}
+#else
+#define xml_parser_info(parser, message) {}
+#endif
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Records an error unless an earlier one has been recorded already
+ */
+static void xml_error_set(struct xml_error* error, enum xml_error_code code, size_t offset, char const* message) {
+	if (!error || (XML_ERROR_NONE != error->code)) {
+		return;
+	}
+
+	error->code = code;
+	error->offset = offset;
+	error->message = message;
+	error->path[0] = 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Appends `/name' to the error's path as far as it fits
+ */
+static void xml_error_path(struct xml_error* error, uint8_t const* name, size_t length) {
+	size_t used = strlen(error->path);
+	if (used + 2 > XML_ERROR_MAXIMUM_PATH) {
+		return;
+	}
+	error->path[used++] = '/';
+
+	if (length > XML_ERROR_MAXIMUM_PATH - used - 1) {
+		length = XML_ERROR_MAXIMUM_PATH - used - 1;
+	}
+	memcpy(&error->path[used], name, length);
+	error->path[used + length] = 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Reports an error regarding the parser's source. Only the first error counts,
+ * callers unwinding afterwards cannot override it. The path consists of the
+ * elements currently open while building a tree
+ */
+static void xml_parser_error(struct xml_parser* parser, enum xml_parser_offset offset, enum xml_error_code code, char const* message) {
+
+	/* Not an error yet, the token might be completed by more input
+	 */
+	if (parser->partial && parser->exhausted) {
+		return;
+	}
+	if (!parser->error || (XML_ERROR_NONE != parser->error->code)) {
+		return;
+	}
+
+	size_t character = parser->position;
+	if ((NEXT_CHARACTER == offset) && (character < parser->length)) {
+		character++;
+	}
+	xml_error_set(parser->error, code, character, message);
+
+	size_t i = 0; for (; i < parser->frames.length; ++i) {
+		struct xml_string* name = &parser->frames.elements[i].node->name->name;
+		xml_error_path(parser->error, name->buffer, name->length);
+	}
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return The byte at `offset` relative to the parser's position or
+ *     XML_PARSER_END if the input ends before
+ */
+static int xml_parser_peek(struct xml_parser* parser, enum xml_parser_offset offset) {
+	#ifdef XML_PARSER_STATISTICS
+	__atomic_fetch_add(&xml_parser_peeks, 1, __ATOMIC_RELAXED);
+	#endif
+
+	if (parser->length - parser->position <= (size_t)offset) {
+		parser->exhausted = true;
+		return XML_PARSER_END;
+	}
+	return parser->buffer[parser->position + offset];
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Moves the parser's position n bytes
+ *
+ * @return false iff the input ends before, the parser will be positioned at
+ *     the end of the input
+ */
+static _Bool xml_parser_consume(struct xml_parser* parser, size_t n) {
+
+	/* Debug information
+	 */
+	#ifdef XML_PARSER_VERBOSE
+	#define min(X,Y) ((X) < (Y) ? (X) : (Y))
+	char* consumed = alloca((n + 1) * sizeof(char));
+	memcpy(consumed, &parser->buffer[parser->position], min(n, parser->length - parser->position));
+	consumed[min(n, parser->length - parser->position)] = 0;
+	#undef min
+
+	size_t message_buffer_length = 512;
+	char* message_buffer = alloca(512 * sizeof(char));
+	snprintf(message_buffer, message_buffer_length, "Consuming %li bytes \"%s\"", (long)n, consumed);
+	message_buffer[message_buffer_length - 1] = 0;
+
+	xml_parser_info(parser, message_buffer);
+	#endif
+
+
+	/* Don't go too far
+	 */
+	if (parser->length - parser->position < n) {
+		parser->position = parser->length;
+		return false;
+	}
+
+	/* Move the position forward
+	 */
+	parser->position += n;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ * 
+ * Skips to the next non-whitespace character
+ */
+static void xml_skip_whitespace(struct xml_parser* parser) {
+	xml_parser_info(parser, "whitespace");
+
+	parser->position = parser->scanner->whitespace(parser->buffer, parser->position, parser->length);
+
+	if (parser->position >= parser->length) {
+		parser->exhausted = true;
+	}
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return Position of the next `byte` starting at the parser's position or the
+ *     buffer's length if there is none
+ */
+static size_t xml_parser_find(struct xml_parser* parser, uint8_t byte) {
+	size_t position = parser->position;
+
+	/* The very same search already failed on a shorter buffer
+	 */
+	if ((position == parser->resume.position) && (byte == parser->resume.byte)) {
+		position = parser->resume.searched;
+	}
+
+	position = parser->scanner->byte(parser->buffer, position, parser->length, byte);
+
+	if (position >= parser->length) {
+		parser->exhausted = true;
+		parser->resume.position = parser->position;
+		parser->resume.searched = parser->length;
+		parser->resume.byte = byte;
+	}
+	return position;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Like xml_parser_find but also notes whether the content up to `byte'
+ * contains a reference, so that content without any is not scanned again when
+ * decoding. Only documents are decoded, which are never parsed partially
+ */
+static size_t xml_parser_find_content(struct xml_parser* parser, uint8_t byte, struct xml_token* token) {
+	token->references = false;
+
+	if (!parser->decode) {
+		return xml_parser_find(parser, byte);
+	}
+
+	size_t position = parser->scanner->either(parser->buffer, parser->position, parser->length, byte, '&');
+	if ((position < parser->length) && ('&' == parser->buffer[position])) {
+		token->references = true;
+		position = parser->scanner->byte(parser->buffer, position, parser->length, byte);
+	}
+
+	if (position >= parser->length) {
+		parser->exhausted = true;
+	}
+	return position;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Reads a tag or attribute name
+ *
+ * @return false iff there is no name at the parser's position
+ */
+static _Bool xml_lex_name(struct xml_parser* parser, struct xml_string* name) {
+	size_t start = parser->position;
+
+	parser->position = parser->scanner->name_end(parser->buffer, parser->position, parser->length);
+	name->buffer = &parser->buffer[start];
+	name->length = parser->position - start;
+
+	if (parser->position >= parser->length) {
+		parser->exhausted = true;
+	}
+
+	return name->length > 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Lexes an opening tag's name, attributes and end will follow
+ *
+ * ---( Example )---
+ * <tag_name
+ * ---
+ */
+static enum xml_token_type xml_lex_tag_open(struct xml_parser* parser, struct xml_token* token) {
+	xml_parser_info(parser, "tag_open");
+	xml_parser_consume(parser, 1);
+
+	if (!xml_lex_name(parser, &token->name)) {
+		xml_parser_error(parser, CURRENT_CHARACTER, XML_ERROR_SYNTAX, "xml_lex_tag_open::expected tag name");
+		return token->type = XML_TOKEN_ERROR;
+	}
+
+	parser->in_tag = true;
+	return token->type = XML_TOKEN_TAG_OPEN;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Lexes a single attribute or the end of an opening tag. Attribute names and
+ * contents are referenced in place
+ *
+ * ---( Example )---
+ * name="value" other = 'value' />
+ * ---
+ */
+static enum xml_token_type xml_lex_tag_inner(struct xml_parser* parser, struct xml_token* token) {
+	xml_parser_info(parser, "tag_inner");
+	int current = xml_parser_peek(parser, CURRENT_CHARACTER);
+
+	/* `>' or `/>' end the tag
+	 */
+	if ('>' == current) {
+		xml_parser_consume(parser, 1);
+		parser->in_tag = false;
+		return token->type = XML_TOKEN_TAG_END;
+	}
+
+	if ('/' == current) {
+		if ('>' != xml_parser_peek(parser, NEXT_CHARACTER)) {
+			xml_parser_error(parser, NEXT_CHARACTER, XML_ERROR_SYNTAX, "xml_lex_tag_inner::expected `>'");
+			return token->type = XML_TOKEN_ERROR;
+		}
+		xml_parser_consume(parser, 2);
+		parser->in_tag = false;
+		return token->type = XML_TOKEN_TAG_EMPTY;
+	}
+
+	if (XML_PARSER_END == current) {
+		xml_parser_error(parser, NO_CHARACTER, XML_ERROR_UNEXPECTED_END, "xml_lex_tag_inner::unexpected end of tag");
+		return token->type = XML_TOKEN_ERROR;
+	}
+
+	/* Attribute name, `=' may be surrounded by whitespace
+	 */
+	_Bool has_name = xml_lex_name(parser, &token->name);
+	xml_skip_whitespace(parser);
+
+	if (!has_name || ('=' != xml_parser_peek(parser, CURRENT_CHARACTER))) {
+		xml_parser_error(parser, CURRENT_CHARACTER, XML_ERROR_SYNTAX, "xml_lex_tag_inner::expected `='");
+		return token->type = XML_TOKEN_ERROR;
+	}
+	xml_parser_consume(parser, 1);
+	xml_skip_whitespace(parser);
+
+	/* Value is enclosed in either single or double quotes
+	 */
+	int quote = xml_parser_peek(parser, CURRENT_CHARACTER);
+	if (('"' != quote) && ('\'' != quote)) {
+		xml_parser_error(parser, CURRENT_CHARACTER, XML_ERROR_SYNTAX, "xml_lex_tag_inner::expected quote");
+		return token->type = XML_TOKEN_ERROR;
+	}
+	xml_parser_consume(parser, 1);
+
+	size_t start = parser->position;
+	size_t end = xml_parser_find_content(parser, (uint8_t)quote, token);
+	if (end >= parser->length) {
+		parser->position = parser->length;
+		xml_parser_error(parser, NO_CHARACTER, XML_ERROR_UNEXPECTED_END, "xml_lex_tag_inner::unterminated attribute value");
+		return token->type = XML_TOKEN_ERROR;
+	}
+
+	token->content.buffer = &parser->buffer[start];
+	token->content.length = end - start;
+	parser->position = end + 1;
+
+	return token->type = XML_TOKEN_ATTRIBUTE;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Lexes a closing XML tag
+ *
+ * ---( Example )---
+ * </tag_name>
+ * ---
+ */
+static enum xml_token_type xml_lex_tag_close(struct xml_parser* parser, struct xml_token* token) {
+	xml_parser_info(parser, "tag_close");
+	xml_parser_consume(parser, 2);
+
+	if (!xml_lex_name(parser, &token->name)) {
+		xml_parser_error(parser, CURRENT_CHARACTER, XML_ERROR_SYNTAX, "xml_lex_tag_close::expected tag name");
+		return token->type = XML_TOKEN_ERROR;
+	}
+	xml_skip_whitespace(parser);
+
+	/* Consume `>'
+	 */
+	if ('>' != xml_parser_peek(parser, CURRENT_CHARACTER)) {
+		xml_parser_error(parser, CURRENT_CHARACTER, XML_ERROR_SYNTAX, "xml_lex_tag_close::expected tag end");
+		return token->type = XML_TOKEN_ERROR;
+	}
+	xml_parser_consume(parser, 1);
+
+	return token->type = XML_TOKEN_TAG_CLOSE;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Lexes a tag's content, leading whitespace has already been skipped
+ *
+ * ---( Example )---
+ *     this is
+ *   a
+ *       tag {} content
+ * ---
+ *
+ * @warning CDATA etc. is _not_ and will never be supported
+ */
+static enum xml_token_type xml_lex_text(struct xml_parser* parser, struct xml_token* token) {
+	xml_parser_info(parser, "text");
+	size_t start = parser->position;
+
+	/* Consume until `<' is reached
+	 */
+	parser->position = xml_parser_find_content(parser, '<', token);
+	size_t length = parser->position - start;
+
+	/* Next character must be an `<' or we have reached end of file
+	 */
+	if (parser->position >= parser->length) {
+		xml_parser_error(parser, NO_CHARACTER, XML_ERROR_UNEXPECTED_END, "xml_lex_text::expected <");
+		return token->type = XML_TOKEN_ERROR;
+	}
+
+	/* Ignore tailing whitespace
+	 */
+	while ((length > 0) && xml_is_whitespace(parser->buffer[start + length - 1])) {
+		length--;
+	}
+
+	token->content.buffer = &parser->buffer[start];
+	token->content.length = length;
+	return token->type = XML_TOKEN_TEXT;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Reads the next token. Every byte of the input is examined a bounded number
+ * of times, whitespace between tokens is skipped by the scanning kernels
+ */
+static enum xml_token_type xml_lexer_next(struct xml_parser* parser, struct xml_token* token) {
+	parser->exhausted = false;
+	xml_skip_whitespace(parser);
+	parser->token = parser->position;
+
+	if (parser->in_tag) {
+		return xml_lex_tag_inner(parser, token);
+	}
+
+	int current = xml_parser_peek(parser, CURRENT_CHARACTER);
+	if (XML_PARSER_END == current) {
+		return token->type = XML_TOKEN_END;
+	}
+	if ('<' != current) {
+		return xml_lex_text(parser, token);
+	}
+	if ('/' == xml_parser_peek(parser, NEXT_CHARACTER)) {
+		return xml_lex_tag_close(parser, token);
+	}
+	return xml_lex_tag_open(parser, token);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Skips the element whose opening tag name has just been read, without
+ * building any nodes. The element is lexed and checked against the same
+ * grammar as xml_parse_node, so a lazy parse accepts exactly the documents an
+ * eager one does. Names of the open elements are kept above the attributes
+ * collected so far, so the scratch stack's capacity is reused
+ *
+ * @return false iff the element is malformed, nests deeper than `max_depth'
+ *     or the system is out of memory
+ */
+static _Bool xml_parser_skip_element(struct xml_parser* parser, struct xml_token* token) {
+	size_t const base = parser->attributes.length;
+	size_t depth = 0;
+	enum xml_parser_state state = XML_PARSER_EXPECT_CHILD;
+	_Bool const reporting = parser->error && (XML_ERROR_NONE == parser->error->code);
+
+	/* Opening tag of the element itself has been lexed already
+	 */
+	do {
+		switch (depth ? xml_lexer_next(parser, token) : XML_TOKEN_TAG_OPEN) {
+
+			case XML_TOKEN_TAG_OPEN:
+				if ((XML_PARSER_EXPECT_CONTENT != state) && (XML_PARSER_EXPECT_CHILD != state)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parser_skip_element::unexpected opening tag");
+					goto error;
+				}
+				if (parser->max_depth && (parser->frames.length + depth >= parser->max_depth)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_MAXIMUM_DEPTH, "xml_parser_skip_element::maximum depth exceeded");
+					goto error;
+				}
+				if (!xml_array_reserve(parser->arena->allocator, (void**)&parser->attributes.elements, &parser->attributes.capacity, parser->attributes.length, 1, sizeof(struct xml_attribute))) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parser_skip_element::out of memory");
+					goto error;
+				}
+				parser->attributes.elements[parser->attributes.length++].content = token->name;
+				depth++;
+				state = XML_PARSER_EXPECT_ATTRIBUTE;
+				break;
+
+			case XML_TOKEN_ATTRIBUTE:
+				break;
+
+			case XML_TOKEN_TAG_END:
+				state = XML_PARSER_EXPECT_CONTENT;
+				break;
+
+			case XML_TOKEN_TAG_EMPTY:
+				goto element_end;
+
+			case XML_TOKEN_TEXT:
+				if (XML_PARSER_EXPECT_CONTENT != state) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parser_skip_element::unexpected text");
+					goto error;
+				}
+				state = XML_PARSER_EXPECT_CLOSE;
+				break;
+
+			case XML_TOKEN_TAG_CLOSE:
+				if (XML_PARSER_EXPECT_ATTRIBUTE == state) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parser_skip_element::unexpected closing tag");
+					goto error;
+				}
+				if (!xml_string_equals(&parser->attributes.elements[parser->attributes.length - 1].content, &token->name)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_TAG_MISMATCH, "xml_parser_skip_element::tag missmatch");
+					goto error;
+				}
+
+			element_end:
+				parser->attributes.length--;
+				depth--;
+				state = XML_PARSER_EXPECT_CHILD;
+				break;
+
+			case XML_TOKEN_END:
+				xml_parser_error(parser, NO_CHARACTER, XML_ERROR_UNEXPECTED_END, "xml_parser_skip_element::unexpected end of document");
+				goto error;
+
+			case XML_TOKEN_ERROR:
+				goto error;
+		}
+	} while (depth);
+	return true;
+
+error:
+
+	/* Skipped elements are open as well
+	 */
+	if (reporting && (XML_ERROR_NONE != parser->error->code)) {
+		size_t i = base; for (; i < parser->attributes.length; ++i) {
+			struct xml_string* name = &parser->attributes.elements[i].content;
+			xml_error_path(parser->error, name->buffer, name->length);
+		}
+	}
+	parser->attributes.length = base;
+	return false;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Decodes the references of a string within the parser's buffer in place if
+ * the parser is supposed to
+ *
+ * @return true iff the buffer has been modified
+ */
+static _Bool xml_parser_decode(struct xml_parser* parser, struct xml_string* string) {
+	if (!parser->decode || !string->length) {
+		return false;
+	}
+
+	size_t length = string->length;
+	string->length = xml_decode(parser->scanner, string->buffer, length, (uint8_t*)string->buffer, length);
+
+	return string->length != length;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Creates a lazy node for the element whose opening tag name has
+ * just been read and skips the rest of the element
+ *
+ * @return The node or 0 if the element could not be skipped
+ */
+static struct xml_node* xml_parse_lazy_node(struct xml_parser* parser, struct xml_token* token) {
+	size_t start = parser->token;
+
+	struct xml_node* node = xml_arena_alloc(parser->arena, sizeof(struct xml_node));
+	if (!node || !(node->name = xml_symbols_intern(parser->symbols, &token->name))) {
+		xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_lazy_node::out of memory");
+		return 0;
+	}
+	if (!xml_parser_skip_element(parser, token)) {
+		return 0;
+	}
+
+	node->content.buffer = &parser->buffer[start];
+	node->content.length = parser->position - start;
+	node->source = node->content;
+	node->attributes = 0;
+	node->children_length = 0;
+	node->attributes_length = 0;
+	node->index = 0;
+	return node;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Completes the innermost open element once its closing tag has been read by
+ * moving its attributes and children from the scratch stacks into a single
+ * arena allocation
+ *
+ * @return false iff the system is out of memory or the element has too many
+ *     attributes or children
+ */
+static _Bool xml_parse_node_end(struct xml_parser* parser) {
+	struct xml_parser_frame* frame = &parser->frames.elements[--parser->frames.length];
+	struct xml_node* node = frame->node;
+
+	size_t attributes = parser->attributes.length - frame->attributes;
+	size_t children = parser->children.length - frame->children;
+
+	if ((attributes > UINT32_MAX) || (children > UINT32_MAX)) {
+		return false;
+	}
+	node->attributes_length = (uint32_t)attributes;
+	node->children_length = (uint32_t)children;
+	node->attributes = 0;
+
+	if (attributes || children) {
+		node->attributes = xml_arena_alloc(parser->arena, attributes * sizeof(struct xml_attribute) + children * sizeof(struct xml_node*));
+		if (!node->attributes) {
+			return false;
+		}
+	}
+	if (attributes) {
+		memcpy(node->attributes, &parser->attributes.elements[frame->attributes], attributes * sizeof(struct xml_attribute));
+	}
+	if (children) {
+		memcpy(xml_node_child_array(node), &parser->children.elements[frame->children], children * sizeof(struct xml_node*));
+	}
+
+	parser->attributes.length = frame->attributes;
+	parser->children.length = frame->children;
+	node->source.length = (size_t)(&parser->buffer[parser->position] - node->source.buffer);
+
+	/* Root node will be picked up by the caller
+	 */
+	return !parser->frames.length || xml_stack_push(parser->arena->allocator, &parser->children, node);
+}
+
+
+
+/**
+ * [PRIVATE]
+ * 
+ * Parses an XML fragment node including all its descendants. Instead of
+ * recursing, open elements are kept on the parser's frame stack. The outermost
+ * element is stored in `node' if given.
+ *
+ * A lazy parser only creates lazy nodes for the children
+ *
+ * ---( Example without children )---
+ * <Node>Text</Node>
+ * ---
+ *
+ * ---( Example with children )---
+ * <Parent>
+ *     <Child>Text</Child>
+ *     <Child>Text</Child>
+ *     <Test>Content</Test>
+ * </Parent>
+ * ---
+ */
+static struct xml_node* xml_parse_node(struct xml_parser* parser, struct xml_node* node) {
+	xml_parser_info(parser, "node");
+
+	enum xml_parser_state state = XML_PARSER_EXPECT_ROOT;
+	struct xml_token token;
+
+	while (XML_PARSER_DONE != state) {
+		switch (xml_lexer_next(parser, &token)) {
+
+			/* New element, attributes will follow
+			 */
+			case XML_TOKEN_TAG_OPEN:
+				if (		(XML_PARSER_EXPECT_ROOT != state)
+					&&	(XML_PARSER_EXPECT_CONTENT != state)
+					&&	(XML_PARSER_EXPECT_CHILD != state)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parse_node::unexpected opening tag");
+					return 0;
+				}
+				if (parser->max_depth && (parser->frames.length >= parser->max_depth)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_MAXIMUM_DEPTH, "xml_parse_node::maximum depth exceeded");
+					return 0;
+				}
+
+				/* Children of lazy parsers are only skipped
+				 */
+				if (parser->lazy && parser->frames.length) {
+					struct xml_node* child = xml_parse_lazy_node(parser, &token);
+
+					if (!child || !xml_stack_push(parser->arena->allocator, &parser->children, child)) {
+						return 0;
+					}
+					state = XML_PARSER_EXPECT_CHILD;
+					break;
+				}
+
+				if (XML_PARSER_EXPECT_ROOT != state || !node) {
+					node = xml_arena_alloc(parser->arena, sizeof(struct xml_node));
+				}
+				if (!node || !xml_array_reserve(parser->arena->allocator, (void**)&parser->frames.elements, &parser->frames.capacity, parser->frames.length, 1, sizeof(struct xml_parser_frame))) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory");
+					return 0;
+				}
+				node->name = xml_symbols_intern(parser->symbols, &token.name);
+				if (!node->name) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory");
+					return 0;
+				}
+				node->content.buffer = 0;
+				node->content.length = 0;
+				node->source.buffer = &parser->buffer[parser->token];
+				node->index = 0;
+
+				parser->frames.elements[parser->frames.length].node = node;
+				parser->frames.elements[parser->frames.length].children = parser->children.length;
+				parser->frames.elements[parser->frames.length].attributes = parser->attributes.length;
+				parser->frames.length++;
+
+				state = XML_PARSER_EXPECT_ATTRIBUTE;
+				break;
+
+			/* Collect attributes until the element ends
+			 */
+			case XML_TOKEN_ATTRIBUTE: {
+				if (!xml_array_reserve(parser->arena->allocator, (void**)&parser->attributes.elements, &parser->attributes.capacity, parser->attributes.length, 1, sizeof(struct xml_attribute))) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory");
+					return 0;
+				}
+				struct xml_attribute* attribute = &parser->attributes.elements[parser->attributes.length++];
+
+				attribute->name = xml_symbols_intern(parser->symbols, &token.name);
+				if (!attribute->name) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory");
+					return 0;
+				}
+				attribute->content = token.content;
+				if (		token.references
+					&&	xml_parser_decode(parser, &attribute->content)
+					&&	!xml_edits_push(parser->arena->allocator, parser->edits, parser->frames.elements[parser->frames.length - 1].node)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory");
+					return 0;
+				}
+				break;
+			}
+
+			/* Either text content or children are to be expected, unless
+			 * the tag is self closing
+			 */
+			case XML_TOKEN_TAG_END:
+			case XML_TOKEN_TAG_EMPTY:
+				if (XML_TOKEN_TAG_END == token.type) {
+					state = XML_PARSER_EXPECT_CONTENT;
+					break;
+				}
+				goto node_end;
+
+			/* Text content has to be followed by the closing tag
+			 */
+			case XML_TOKEN_TEXT: {
+				if (XML_PARSER_EXPECT_CONTENT != state) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parse_node::unexpected text");
+					return 0;
+				}
+				struct xml_node* element = parser->frames.elements[parser->frames.length - 1].node;
+				if (		token.references
+					&&	xml_parser_decode(parser, &token.content)
+					&&	!xml_edits_push(parser->arena->allocator, parser->edits, element)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory");
+					return 0;
+				}
+				element->content = token.content;
+				state = XML_PARSER_EXPECT_CLOSE;
+				break;
+			}
+
+			/* Close tag has to match open tag
+			 */
+			case XML_TOKEN_TAG_CLOSE:
+				if ((XML_PARSER_EXPECT_ROOT == state) || (XML_PARSER_EXPECT_ATTRIBUTE == state)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parse_node::unexpected closing tag");
+					return 0;
+				}
+				node = parser->frames.elements[parser->frames.length - 1].node;
+
+				if (!xml_string_equals(&node->name->name, &token.name)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_TAG_MISMATCH, "xml_parse_node::tag missmatch");
+					return 0;
+				}
+
+			node_end:
+				if (!xml_parse_node_end(parser)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_node::out of memory or too many children");
+					return 0;
+				}
+				state = parser->frames.length ? XML_PARSER_EXPECT_CHILD : XML_PARSER_DONE;
+				break;
+
+			case XML_TOKEN_END:
+				xml_parser_error(parser, NO_CHARACTER, XML_ERROR_UNEXPECTED_END, "xml_parse_node::unexpected end of document");
+				return 0;
+
+			case XML_TOKEN_ERROR:
+				return 0;
+		}
+	}
+
+	/* Last completed element is the root
+	 */
+	return node;
+}
+
+
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Lazy nodes hold their whole markup as content. No other node does, since
+ * text content starts behind the opening tag and replaced strings are copies
+ *
+ * @return true iff the node has not been materialized yet
+ */
+static inline _Bool xml_node_lazy(struct xml_node const* node) {
+	return node->content.buffer == node->source.buffer;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Parses attributes and content of a lazy node, its children are lazy again.
+ * The markup has been checked while skipping it, so only running out of
+ * memory fails. The node stays empty then and the failure is recorded as the
+ * document's error
+ */
+static void xml_node_materialize(struct xml_node* node) {
+	struct xml_string markup = node->content;
+	struct xml_symbols* symbols = node->name->symbols;
+	struct xml_document* document = xml_node_document(node);
+
+	struct xml_parser parser = {
+		.buffer = (uint8_t*)markup.buffer,
+		.position = 0,
+		.length = markup.length,
+		.in_tag = false,
+
+		.partial = false,
+		.exhausted = false,
+		.token = 0,
+		.resume = {0},
+
+		.scanner = xml_scanner_select(),
+		.error = &document->error,
+		.arena = symbols->arena,
+		.symbols = symbols,
+		.lazy = true,
+		.decode = document->decode,
+		.edits = &document->edits,
+		.children = {0},
+		.attributes = {0},
+
+		.frames = {0},
+		.max_depth = 0
+	};
+
+	if (!xml_parse_node(&parser, node)) {
+		node->content.buffer = 0;
+		node->content.length = 0;
+		node->attributes = 0;
+		node->children_length = 0;
+		node->attributes_length = 0;
+	}
+
+	xml_free(parser.arena->allocator, parser.children.elements);
+	xml_free(parser.arena->allocator, parser.attributes.elements);
+	xml_free(parser.arena->allocator, parser.frames.elements);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Materializes lazy nodes before their contents are accessed
+ */
+static inline struct xml_node* xml_node_load(struct xml_node* node) {
+	if (xml_node_lazy(node)) {
+		xml_node_materialize(node);
+	}
+	return node;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Claims and runs workers of the pool's current work until none is left,
+ * `lock' has to be held and is held again on return
+ */
+#ifdef XML_PARSER_THREADS
+static void xml_pool_work(struct xml_pool* pool) {
+	while (pool->next < pool->jobs) {
+		void* worker = (uint8_t*)pool->workers + pool->next++ * pool->size;
+		void* (*function)(void*) = pool->function;
+
+		pthread_mutex_unlock(&pool->lock);
+		function(worker);
+		pthread_mutex_lock(&pool->lock);
+
+		if (!--pool->pending) {
+			pthread_cond_signal(&pool->idle);
+		}
+	}
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Body of the pool's threads, which sleep until there is work or the pool is
+ * freed
+ */
+static void* xml_pool_thread(void* argument) {
+	struct xml_pool* pool = argument;
+
+	pthread_mutex_lock(&pool->lock);
+	while (!pool->stop) {
+		xml_pool_work(pool);
+
+		if (!pool->stop) {
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+#endif
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Runs `function' for all `length' workers of `size' bytes each on the pool's
+ * threads and the calling thread, returning once all are done. Without a
+ * pool, the calling thread runs all workers one after the other. Workers
+ * may thus not wait for each other
+ */
+static void xml_pool_run(struct xml_pool* pool, void* workers, size_t size, size_t length, void* (*function)(void*)) {
+	#ifdef XML_PARSER_THREADS
+	if (pool) {
+		pthread_mutex_lock(&pool->run);
+		pthread_mutex_lock(&pool->lock);
+
+		pool->workers = workers;
+		pool->size = size;
+		pool->jobs = length;
+		pool->function = function;
+		pool->next = 0;
+		pool->pending = length;
+		pthread_cond_broadcast(&pool->wake);
+
+		xml_pool_work(pool);
+		while (pool->pending) {
+			pthread_cond_wait(&pool->idle, &pool->lock);
+		}
+
+		pthread_mutex_unlock(&pool->lock);
+		pthread_mutex_unlock(&pool->run);
+		return;
+	}
+	#else
+	(void)pool;
+	#endif
+
+	size_t i = 0; for (; i < length; ++i) {
+		function((uint8_t*)workers + i * size);
+	}
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_pool* xml_pool_create(struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
+	struct xml_pool* pool = xml_alloc(&allocator, sizeof(struct xml_pool));
+	if (!pool) {
+		return 0;
+	}
+	pool->allocator = allocator;
+
+	#ifdef XML_PARSER_THREADS
+	size_t threads = (options && (options->threads > 1)) ? options->threads - 1 : 0;
+
+	pool->threads = threads ? xml_alloc(&allocator, threads * sizeof(pthread_t)) : 0;
+	pool->length = 0;
+	pool->jobs = 0;
+	pool->next = 0;
+	pool->pending = 0;
+	pool->stop = false;
+
+	_Bool run = !pthread_mutex_init(&pool->run, 0);
+	_Bool lock = !pthread_mutex_init(&pool->lock, 0);
+	_Bool wake = !pthread_cond_init(&pool->wake, 0);
+	_Bool idle = !pthread_cond_init(&pool->idle, 0);
+
+	if ((threads && !pool->threads) || !run || !lock || !wake || !idle) {
+		if (run) {
+			pthread_mutex_destroy(&pool->run);
+		}
+		if (lock) {
+			pthread_mutex_destroy(&pool->lock);
+		}
+		if (wake) {
+			pthread_cond_destroy(&pool->wake);
+		}
+		if (idle) {
+			pthread_cond_destroy(&pool->idle);
+		}
+
+		xml_free(&allocator, pool->threads);
+		xml_free(&allocator, pool);
+		return 0;
+	}
+
+	/* Should not all threads start, the calling thread does their share
+	 */
+	for (; pool->length < threads; ++pool->length) {
+		if (pthread_create(&pool->threads[pool->length], 0, xml_pool_thread, pool)) {
+			break;
+		}
+		#ifdef XML_PARSER_STATISTICS
+		xml_pool_threads_started++;
+		#endif
+	}
+	return pool;
+
+	#else
+	return pool;
+	#endif
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_pool_free(struct xml_pool* pool) {
+	struct xml_allocator allocator = pool->allocator;
+
+	#ifdef XML_PARSER_THREADS
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	size_t i = 0; for (; i < pool->length; ++i) {
+		pthread_join(pool->threads[i], 0);
+	}
+
+	pthread_cond_destroy(&pool->idle);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_mutex_destroy(&pool->run);
+	xml_free(&allocator, pool->threads);
+	#endif
+
+	xml_free(&allocator, pool);
+}
+
+
+
+#ifdef XML_PARSER_THREADS
+/**
+ * [PRIVATE]
+ *
+ * Share of a document parsed by one thread.
+ *
+ * While looking for split points, `[begin, end)' is an arbitrary chunk.
+ * `scan.depth' is by how much the nesting level changes within the chunk and
+ * `scan.level' the level at its start relative to the root's children. If
+ * `scan.valid', a child of the root starts at `scan.split'.
+ *
+ * While parsing, `[begin, end)' contains complete children of the root, which
+ * are parsed with a parser of its own. `close' will be the position the
+ * elements ended at. References are only decoded once all ranges have been
+ * parsed if `decode' is set, since the buffer has to stay unchanged in case
+ * the document has to be parsed sequentially instead
+ */
+struct xml_parallel_worker {
+	size_t begin;
+	size_t end;
+
+	struct {
+		ptrdiff_t depth;
+		ptrdiff_t level;
+		size_t split;
+		_Bool valid;
+	} scan;
+
+	struct xml_parser parser;
+	struct xml_arena arena;
+	struct xml_symbols symbols;
+	struct xml_stack edits;
+	size_t close;
+	_Bool forward;
+	_Bool decode;
+	_Bool success;
+};
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Computes how the nesting level changes within the worker's chunk, without
+ * looking at individual tags. Quotes are ignored, so `/>' within attribute
+ * values or text would be miscounted. Split points derived from a wrong level
+ * are caught when parsing the ranges though
+ */
+static void* xml_parallel_depth(void* argument) {
+	struct xml_parallel_worker* worker = argument;
+	struct xml_parser* parser = &worker->parser;
+
+	worker->scan.depth = parser->scanner->depth(parser->buffer, worker->begin, worker->end);
+	return 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return Position of the `>' ending the tag `position' is in or the buffer's
+ *     length if there is none. Quoted attribute values, which may contain
+ *     `>', are skipped as a whole
+ */
+static size_t xml_parser_tag_end(struct xml_parser* parser, size_t position) {
+	uint8_t const* buffer = parser->buffer;
+	size_t length = parser->length;
+
+	for (; position < length; ++position) {
+		uint8_t character = buffer[position];
+
+		if ('>' == character) {
+			return position;
+		}
+		if (('"' == character) || ('\'' == character)) {
+			position = parser->scanner->byte(buffer, position + 1, length, character);
+		}
+	}
+	return length;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Looks for the first child of the root starting in the worker's chunk by
+ * following its tags from the level at the chunk's start. Text may not
+ * contain `<', but attribute values may. If the chunk starts within a quoted
+ * value, its first `<' need not start a tag. The range ending at such a split
+ * point cannot be parsed completely, so the document is parsed sequentially
+ * instead
+ */
+static void* xml_parallel_split(void* argument) {
+	struct xml_parallel_worker* worker = argument;
+	struct xml_parser* parser = &worker->parser;
+	uint8_t const* buffer = parser->buffer;
+	size_t length = parser->length;
+
+	worker->scan.valid = false;
+	worker->scan.split = 0;
+
+	/* The chunk might start within a tag, which might be closed before the
+	 * first `<'
+	 */
+	size_t position = parser->scanner->byte(buffer, worker->begin, worker->end, '<');
+	ptrdiff_t level = worker->scan.level + parser->scanner->depth(buffer, worker->begin, position);
+
+	while (position < worker->end) {
+		if (position + 1 >= length) {
+			break;
+		}
+		_Bool closing = ('/' == buffer[position + 1]);
+
+		if (!closing && !level) {
+			worker->scan.valid = true;
+			worker->scan.split = position;
+			break;
+		}
+
+		position = xml_parser_tag_end(parser, position + 1);
+		if (position >= length) {
+			break;
+		}
+
+		if (closing) {
+			level--;
+		} else if ('/' != buffer[position - 1]) {
+			level++;
+		}
+		position = parser->scanner->byte(buffer, position + 1, worker->end, '<');
+	}
+
+	return 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Parses all elements in the worker's range using its own arena and symbol
+ * table. The range of the last worker ends with the root's closing tag
+ */
+static void* xml_parallel_parse(void* argument) {
+	struct xml_parallel_worker* worker = argument;
+	struct xml_parser* parser = &worker->parser;
+
+	parser->position = worker->begin;
+	parser->length = worker->end;
+	worker->success = false;
+
+	for (;;) {
+		xml_skip_whitespace(parser);
+
+		if (parser->position >= parser->length) {
+			break;
+		}
+		if (		(parser->position + 1 < parser->length)
+			&&	('<' == parser->buffer[parser->position])
+			&&	('/' == parser->buffer[parser->position + 1])) {
+			break;
+		}
+
+		struct xml_node* node = xml_parse_node(parser, 0);
+		if (!node || !xml_stack_push(parser->arena->allocator, &parser->children, node)) {
+			return 0;
+		}
+	}
+
+	worker->close = parser->position;
+	worker->success = true;
+	return 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Replaces the names of all nodes parsed by the worker with the symbols of
+ * the document they have been merged into and decodes their strings. Nothing
+ * needs to be done if all of the worker's symbols have been adopted by the
+ * document and references are not decoded
+ */
+static void* xml_parallel_forward(void* argument) {
+	struct xml_parallel_worker* worker = argument;
+	struct xml_stack* stack = &worker->parser.children;
+	worker->success = false;
+	worker->parser.decode = worker->decode;
+
+	if (!worker->forward && !worker->decode) {
+		stack->length = 0;
+	}
+
+	while (stack->length) {
+		struct xml_node* node = stack->elements[--stack->length];
+		node->name = node->name->forward;
+		if (xml_parser_decode(&worker->parser, &node->content) && !xml_edits_push(worker->arena.allocator, &worker->edits, node)) {
+			return 0;
+		}
+
+		size_t i = 0; for (; i < node->attributes_length; ++i) {
+			node->attributes[i].name = node->attributes[i].name->forward;
+			if (xml_parser_decode(&worker->parser, &node->attributes[i].content) && !xml_edits_push(worker->arena.allocator, &worker->edits, node)) {
+				return 0;
+			}
+		}
+
+		struct xml_node** children = xml_node_child_array(node);
+		for (i = 0; i < node->children_length; ++i) {
+			if (!xml_stack_push(worker->arena.allocator, stack, children[i])) {
+				return 0;
+			}
+		}
+	}
+
+	worker->success = true;
+	return 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Parses the document on the pool's threads by splitting the root's children
+ * into up to `threads' ranges of complete elements. Split points are found by
+ * computing the change of the nesting level within equal sized chunks of the
+ * document in parallel, which tells the level at each chunk's start, and then
+ * following the tags of each chunk until the first child of the root. All
+ * phases run on the same threads, those of a pool of its own if `pool' is 0.
+ *
+ * Each range is parsed with a parser of its own. Their symbols are merged in
+ * document order, so symbols are assigned exactly as by a sequential parse.
+ * Arenas are merged into the document's one at last.
+ *
+ * @return The root node or 0 if the document cannot be parsed in parallel, in
+ *     which case it should be parsed sequentially iff `sequential' is set.
+ *     Once references have been decoded in place, the buffer cannot be
+ *     parsed again
+ */
+static struct xml_node* xml_parse_parallel(struct xml_parser* parser, struct xml_pool* pool, size_t threads, _Bool* sequential) {
+	struct xml_token token;
+	*sequential = true;
+
+	/* Opening tag of the root element has to be followed by children
+	 */
+	if (XML_TOKEN_TAG_OPEN != xml_lexer_next(parser, &token)) {
+		return 0;
+	}
+	struct xml_node* root = xml_arena_alloc(parser->arena, sizeof(struct xml_node));
+	if (!root || !(root->name = xml_symbols_intern(parser->symbols, &token.name))) {
+		return 0;
+	}
+	root->content.buffer = 0;
+	root->content.length = 0;
+	root->source.buffer = &parser->buffer[parser->token];
+	root->index = 0;
+
+	while (XML_TOKEN_TAG_END != xml_lexer_next(parser, &token)) {
+		if (XML_TOKEN_ATTRIBUTE != token.type) {
+			return 0;
+		}
+		if (!xml_array_reserve(parser->arena->allocator, (void**)&parser->attributes.elements, &parser->attributes.capacity, parser->attributes.length, 1, sizeof(struct xml_attribute))) {
+			return 0;
+		}
+		struct xml_attribute* attribute = &parser->attributes.elements[parser->attributes.length++];
+
+		if (!(attribute->name = xml_symbols_intern(parser->symbols, &token.name))) {
+			return 0;
+		}
+		attribute->content = token.content;
+	}
+
+	xml_skip_whitespace(parser);
+	size_t start = parser->position;
+
+	if (		(start + 1 >= parser->length)
+		||	('<' != parser->buffer[start])
+		||	('/' == parser->buffer[start + 1])) {
+		return 0;
+	}
+
+	if (threads > (parser->length - start) / XML_PARALLEL_MINIMUM_CHUNK_SIZE) {
+		threads = (parser->length - start) / XML_PARALLEL_MINIMUM_CHUNK_SIZE;
+	}
+	if (threads < 2) {
+		return 0;
+	}
+
+	struct xml_allocator const* allocator = parser->arena->allocator;
+	struct xml_pool* own = 0;
+	if (!pool) {
+		struct xml_options settings = {0};
+		settings.threads = threads;
+		settings.allocator = allocator;
+
+		if (!(pool = own = xml_pool_create(&settings))) {
+			return 0;
+		}
+	}
+
+	struct xml_parallel_worker* workers = xml_alloc(allocator, threads * sizeof(struct xml_parallel_worker));
+	if (!workers) {
+		if (own) {
+			xml_pool_free(own);
+		}
+		return 0;
+	}
+	memset(workers, 0, threads * sizeof(struct xml_parallel_worker));
+	size_t i = 0; for (; i < threads; ++i) {
+		workers[i].begin = start + i * ((parser->length - start) / threads);
+		workers[i].end = (i + 1 == threads) ? parser->length : start + (i + 1) * ((parser->length - start) / threads);
+
+		xml_arena_init(&workers[i].arena, allocator, workers[i].end - workers[i].begin);
+		xml_symbols_init(&workers[i].symbols, &workers[i].arena);
+
+		workers[i].parser = *parser;
+		workers[i].parser.in_tag = false;
+		workers[i].parser.arena = &workers[i].arena;
+		workers[i].parser.symbols = &workers[i].symbols;
+		workers[i].parser.children = (struct xml_stack){0};
+		workers[i].parser.attributes.elements = 0;
+		workers[i].parser.attributes.length = 0;
+		workers[i].parser.attributes.capacity = 0;
+		workers[i].parser.frames.elements = 0;
+		workers[i].parser.frames.length = 0;
+		workers[i].parser.frames.capacity = 0;
+		workers[i].parser.decode = false;
+		workers[i].parser.edits = &workers[i].edits;
+		workers[i].parser.error = 0;
+		workers[i].decode = parser->decode;
+
+		/* Root is one level above the workers' elements
+		 */
+		if (parser->max_depth) {
+			workers[i].parser.max_depth = parser->max_depth - 1;
+		}
+	}
+	_Bool success = !parser->max_depth || (parser->max_depth > 1);
+	if (success) {
+		xml_pool_run(pool, workers, sizeof(struct xml_parallel_worker), threads, xml_parallel_depth);
+	}
+
+	/* Levels at the chunks' starts follow from their predecessors, then each
+	 * chunk is split at its first child of the root
+	 */
+	ptrdiff_t level = 0;
+	for (i = 0; success && (i < threads); ++i) {
+		workers[i].scan.level = level;
+		level += workers[i].scan.depth;
+	}
+	if (success) {
+		xml_pool_run(pool, workers, sizeof(struct xml_parallel_worker), threads, xml_parallel_split);
+	}
+
+	size_t ranges = 0;
+	for (i = 0; success && (i < threads); ++i) {
+		if (workers[i].scan.valid) {
+			workers[ranges++].begin = workers[i].scan.split;
+		}
+	}
+	for (i = 0; i < ranges; ++i) {
+		workers[i].end = (i + 1 < ranges) ? workers[i + 1].begin : parser->length;
+	}
+	success = success && (ranges > 1) && (workers[0].begin == start);
+
+	/* Parse all ranges, only the last one may end with a closing tag
+	 */
+	if (success) {
+		xml_pool_run(pool, workers, sizeof(struct xml_parallel_worker), ranges, xml_parallel_parse);
+	}
+
+	for (i = 0; success && (i < ranges); ++i) {
+		success = workers[i].success && ((i + 1 == ranges) || (workers[i].close == workers[i].end));
+	}
+
+	/* Merge symbols in document order
+	 */
+	for (i = 0; success && (i < ranges); ++i) {
+		size_t j = 0; for (; success && (j < workers[i].symbols.symbols.length); ++j) {
+			struct xml_symbol* symbol = workers[i].symbols.symbols.elements[j];
+
+			success = xml_symbols_adopt(parser->symbols, symbol);
+			workers[i].forward |= (symbol->forward != symbol);
+		}
+	}
+
+	/* Root has to be closed right after its children
+	 */
+	if (success) {
+		parser->position = workers[ranges - 1].close;
+		parser->in_tag = false;
+
+		success =	(XML_TOKEN_TAG_CLOSE == xml_lexer_next(parser, &token))
+			&&	xml_string_equals(&root->name->name, &token.name);
+	}
+
+	/* Collect the root's children before the workers' stacks are reused to
+	 * traverse their nodes
+	 */
+	for (i = 0; success && (i < ranges); ++i) {
+		size_t j = 0; for (; success && (j < workers[i].parser.children.length); ++j) {
+			success = xml_stack_push(parser->arena->allocator, &parser->children, workers[i].parser.children.elements[j]);
+		}
+	}
+	success = success && xml_array_reserve(parser->arena->allocator, (void**)&parser->frames.elements, &parser->frames.capacity, 0, 1, sizeof(struct xml_parser_frame));
+
+	/* The document has been parsed successfully, only decoding in place and
+	 * running out of memory remain
+	 */
+	if (success) {
+		*sequential = !parser->decode;
+		xml_pool_run(pool, workers, sizeof(struct xml_parallel_worker), ranges, xml_parallel_forward);
+	}
+	for (i = 0; success && (i < ranges); ++i) {
+		success = workers[i].success;
+
+		size_t j = 0; for (; success && (j < workers[i].edits.length); ++j) {
+			success = xml_stack_push(allocator, parser->edits, workers[i].edits.elements[j]);
+		}
+	}
+
+	/* Workers' nodes are owned by the document from now on
+	 */
+	for (i = 0; i < threads; ++i) {
+		if (success) {
+			xml_arena_merge(parser->arena, &workers[i].arena);
+		}
+		xml_arena_free(&workers[i].arena);
+		xml_symbols_free(&workers[i].symbols);
+		xml_free(allocator, workers[i].parser.children.elements);
+		xml_free(allocator, workers[i].parser.attributes.elements);
+		xml_free(allocator, workers[i].parser.frames.elements);
+		xml_free(allocator, workers[i].edits.elements);
+	}
+	xml_free(allocator, workers);
+
+	if (own) {
+		xml_pool_free(own);
+	}
+
+	if (!success) {
+		return 0;
+	}
+	for (i = 0; i < parser->attributes.length; ++i) {
+		if (xml_parser_decode(parser, &parser->attributes.elements[i].content) && !xml_edits_push(allocator, parser->edits, root)) {
+			return 0;
+		}
+	}
+	parser->frames.elements[0].node = root;
+	parser->frames.elements[0].children = 0;
+	parser->frames.elements[0].attributes = 0;
+	parser->frames.length = 1;
+
+	return xml_parse_node_end(parser) ? root : 0;
+}
+#endif
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_parse_document(uint8_t* buffer, size_t length) {
+	return xml_parse_document_ex(buffer, length, 0);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Takes back the scratch stacks lent to `parser', which may have grown
+ */
+static void xml_parser_scratch_keep(struct xml_parser_scratch* scratch, struct xml_parser const* parser) {
+	scratch->children.elements = parser->children.elements;
+	scratch->children.length = 0;
+	scratch->children.capacity = parser->children.capacity;
+	scratch->attributes.elements = parser->attributes.elements;
+	scratch->attributes.capacity = parser->attributes.capacity;
+	scratch->frames.elements = parser->frames.elements;
+	scratch->frames.capacity = parser->frames.capacity;
+}
+
+
+
+/**
+ * [PRIVATE]
+ */
+static void xml_parser_scratch_free(struct xml_allocator const* allocator, struct xml_parser_scratch* scratch) {
+	xml_free(allocator, scratch->children.elements);
+	xml_free(allocator, scratch->attributes.elements);
+	xml_free(allocator, scratch->frames.elements);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Parses the root node of `document' using a freshly initialized `parser'.
+ * Should parallel parsing not be possible, the arena and symbols are reset
+ * before starting over sequentially
+ *
+ * @return false iff parsing failed
+ */
+static _Bool xml_parse_document_root(struct xml_parser* parser, struct xml_document* document, struct xml_options const* options) {
+
+	/* An empty buffer can never contain a valid document
+	 */
+	if (!parser->length) {
+		xml_parser_error(parser, NO_CHARACTER, XML_ERROR_EMPTY_DOCUMENT, "xml_parse_document::length equals zero");
+		return false;
+	}
+
+	/* Parse the root node
+	 */
+	if (options->lazy) {
+		struct xml_token token;
+
+		if (XML_TOKEN_TAG_OPEN != xml_lexer_next(parser, &token)) {
+			xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parse_document::expected opening tag");
+			return false;
+		}
+		document->root = xml_parse_lazy_node(parser, &token);
+	} else {
+		#ifdef XML_PARSER_THREADS
+		if (options->threads > 1) {
+			_Bool sequential;
+			struct xml_error* error = parser->error;
+
+			/* Errors are reported by the sequential parse
+			 */
+			parser->error = 0;
+			document->root = xml_parse_parallel(parser, options->pool, options->threads, &sequential);
+			parser->error = error;
+
+			/* Start over sequentially if the document is not suited for
+			 * parallel parsing
+			 */
+			if (!document->root && !sequential) {
+				xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_parse_document::out of memory");
+				return false;
+			}
+			if (!document->root) {
+				xml_symbols_reset(&document->symbols);
+				xml_arena_reset(&document->arena);
+
+				parser->position = 0;
+				parser->in_tag = false;
+				parser->children.length = 0;
+				parser->attributes.length = 0;
+				parser->frames.length = 0;
+				document->edits.length = 0;
+			}
+		}
+		#endif
+
+		if (!document->root) {
+			document->root = xml_parse_node(parser, 0);
+		}
+	}
+	if (!document->root) {
+		xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_parse_document::parsing document failed");
+		return false;
+	}
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Like xml_parse_document_ex, but the parser's scratch stacks are taken from
+ * and returned to `scratch'
+ */
+static struct xml_document* xml_parse_document_reusing(uint8_t* buffer, size_t length, struct xml_options const* options, struct xml_parser_scratch* scratch) {
+	struct xml_options const defaults = {0};
+	if (!options) {
+		options = &defaults;
+	}
+	if (options->error) {
+		options->error->code = XML_ERROR_NONE;
+	}
+
+	/* Prepare document, it owns the arena all nodes will be allocated from
+	 */
+	struct xml_allocator allocator = xml_allocator_select(options);
+	struct xml_document* document = xml_alloc(&allocator, sizeof(struct xml_document));
+	if (!document) {
+		xml_error_set(options->error, XML_ERROR_OUT_OF_MEMORY, 0, "xml_parse_document::out of memory");
+		return 0;
+	}
+	document->buffer.buffer = buffer;
+	document->buffer.length = length;
+	document->buffer.mapped = false;
+	document->allocator = allocator;
+	document->root = 0;
+	document->decode = options->decode;
+	document->edits = (struct xml_stack){0};
+	document->error.code = XML_ERROR_NONE;
+	xml_arena_init(&document->arena, &document->allocator, options->lazy ? 0 : length);
+	xml_symbols_init(&document->symbols, &document->arena);
+
+	/* Initialize parser
+	 */
+	struct xml_parser parser = {
+		.buffer = buffer,
+		.position = 0,
+		.length = length,
+		.in_tag = false,
+
+		.partial = false,
+		.exhausted = false,
+		.token = 0,
+		.resume = {0},
+
+		.scanner = xml_scanner_select(),
+		.error = options->error,
+		.arena = &document->arena,
+		.symbols = &document->symbols,
+		.lazy = options->lazy,
+		.decode = options->decode,
+		.edits = &document->edits,
+		.children = {scratch->children.elements, 0, scratch->children.capacity},
+		.attributes = {scratch->attributes.elements, 0, scratch->attributes.capacity},
+
+		.frames = {scratch->frames.elements, 0, scratch->frames.capacity},
+		.max_depth = options->max_depth
+	};
+
+	_Bool parsed = xml_parse_document_root(&parser, document, options);
+	xml_parser_scratch_keep(scratch, &parser);
+
+	/* Release everything parsed so far at once
+	 */
+	if (!parsed) {
+		xml_symbols_free(&document->symbols);
+		xml_arena_free(&document->arena);
+		xml_free(&allocator, document->edits.elements);
+		xml_free(&allocator, document);
+		return 0;
+	}
+	return document;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_parse_document_ex(uint8_t* buffer, size_t length, struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
+	struct xml_parser_scratch scratch = {0};
+
+	struct xml_document* document = xml_parse_document_reusing(buffer, length, options, &scratch);
+	xml_parser_scratch_free(&allocator, &scratch);
+	return document;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_error_position(struct xml_error const* error, uint8_t const* buffer, size_t* line, size_t* column) {
+	size_t lines = 1;
+	size_t start = 0;
+
+	while (start < error->offset) {
+		uint8_t const* newline = memchr(&buffer[start], '\n', error->offset - start);
+		if (!newline) {
+			break;
+		}
+		lines++;
+		start = (size_t)(newline - buffer) + 1;
+	}
+
+	*line = lines;
+	*column = error->offset - start + 1;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_open_document(FILE* source) {
+	return xml_open_document_ex(source, 0);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_open_document_ex(FILE* source, struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
+	struct xml_error* error = options ? options->error : 0;
+	if (error) {
+		error->code = XML_ERROR_NONE;
+	}
+
+	/* Prepare buffer, large enough for the whole stream if its size is
+	 * known up front
+	 */
+	size_t buffer_size = XML_OPEN_DOCUMENT_CHUNK_SIZE;
+
+	#ifdef XML_PARSER_POSIX
+	struct stat status;
+	long offset = ftell(source);
+
+	if (!fstat(fileno(source), &status) && S_ISREG(status.st_mode) && (offset >= 0) && (status.st_size > offset)) {
+		buffer_size = (size_t)(status.st_size - offset) + 1;
+	}
+	#endif
+
+	size_t document_length = 0;
+	uint8_t* buffer = xml_alloc(&allocator, buffer_size * sizeof(uint8_t));
+
+	/* Read hole file into buffer
+	 */
+	while (buffer) {
+
+		/* Reallocate buffer
+		 */
+		if (document_length == buffer_size) {
+			uint8_t* grown = xml_realloc(&allocator, buffer, 2 * buffer_size);
+
+			if (!grown) {
+				xml_free(&allocator, buffer);
+				buffer = 0;
+				break;
+			}
+			buffer = grown;
+			buffer_size *= 2;
+		}
+
+		size_t read = fread(
+			&buffer[document_length],
+			sizeof(uint8_t), buffer_size - document_length,
+			source
+		);
+		document_length += read;
+
+		if (!read && (feof(source) || ferror(source))) {
+			break;
+		}
+	}
+
+	if (!buffer || ferror(source)) {
+		if (buffer) {
+			xml_error_set(error, XML_ERROR_READ, document_length, "xml_open_document::could not read source");
+		} else {
+			xml_error_set(error, XML_ERROR_OUT_OF_MEMORY, document_length, "xml_open_document::out of memory");
+		}
+		xml_free(&allocator, buffer);
+		fclose(source);
+		return 0;
+	}
+	fclose(source);
+
+	/* Try to parse buffer
+	 */
+	struct xml_document* document = xml_parse_document_ex(buffer, document_length, options);
+
+	if (!document) {
+		xml_free(&allocator, buffer);
+		return 0;
+	}
+	return document;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_open_path(char const* path) {
+	return xml_open_path_ex(path, 0);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_open_path_ex(char const* path, struct xml_options const* options) {
+	struct xml_error* error = options ? options->error : 0;
+	if (error) {
+		error->code = XML_ERROR_NONE;
+	}
+
+	/* Without POSIX, fall back to reading the file into memory
+	 */
+	#ifndef XML_PARSER_POSIX
+	FILE* source = fopen(path, "rb");
+	if (!source) {
+		xml_error_set(error, XML_ERROR_READ, 0, "xml_open_path::could not open file");
+		return 0;
+	}
+	return xml_open_document_ex(source, options);
+
+	#else
+	int descriptor = open(path, O_RDONLY);
+	if (descriptor < 0) {
+		xml_error_set(error, XML_ERROR_READ, 0, "xml_open_path::could not open file");
+		return 0;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) || !S_ISREG(status.st_mode)) {
+		xml_error_set(error, XML_ERROR_READ, 0, "xml_open_path::not a regular file");
+		close(descriptor);
+		return 0;
+	}
+	if (status.st_size <= 0) {
+		xml_error_set(error, XML_ERROR_EMPTY_DOCUMENT, 0, "xml_open_path::file is empty");
+		close(descriptor);
+		return 0;
+	}
+	size_t length = (size_t)status.st_size;
+
+	/* The mapping stays valid after the descriptor has been closed. Pages
+	 * are copied on write, so references can be decoded in place without
+	 * modifying the file
+	 */
+	int protection = (options && options->decode) ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void* mapping = mmap(0, length, protection, MAP_PRIVATE, descriptor, 0);
+	close(descriptor);
+
+	if (MAP_FAILED == mapping) {
+		xml_error_set(error, XML_ERROR_READ, 0, "xml_open_path::could not map file");
+		return 0;
+	}
+	posix_madvise(mapping, length, POSIX_MADV_SEQUENTIAL);
+
+	/* Parse the mapping in place, the document takes ownership
+	 */
+	struct xml_document* document = xml_parse_document_ex(mapping, length, options);
+
+	if (!document) {
+		munmap(mapping, length);
+		return 0;
+	}
+	document->buffer.mapped = true;
+	return document;
+	#endif
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_document_free(struct xml_document* document, bool free_buffer) {
+	struct xml_allocator allocator = document->allocator;
+
+	xml_symbols_free(&document->symbols);
+	xml_arena_free(&document->arena);
+	xml_free(&allocator, document->edits.elements);
+
+	#ifdef XML_PARSER_POSIX
+	if (document->buffer.mapped) {
+		munmap(document->buffer.buffer, document->buffer.length);
+	} else
+	#endif
+	if (free_buffer) {
+		xml_free(&allocator, document->buffer.buffer);
+	}
+	xml_free(&allocator, document);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document_parser* xml_document_parser_create(struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
+	struct xml_document_parser* context = xml_alloc(&allocator, sizeof(struct xml_document_parser));
+	if (!context) {
+		return 0;
+	}
+
+	if (options) {
+		context->options = *options;
+	} else {
+		context->options = (struct xml_options){0};
+	}
+
+	struct xml_document* document = &context->document;
+	document->buffer.buffer = 0;
+	document->buffer.length = 0;
+	document->buffer.mapped = false;
+	document->allocator = allocator;
+	document->root = 0;
+	document->decode = context->options.decode;
+	document->edits = (struct xml_stack){0};
+	document->error.code = XML_ERROR_NONE;
+	xml_arena_init(&document->arena, &document->allocator, 0);
+	xml_symbols_init(&document->symbols, &document->arena);
+
+	context->scratch = (struct xml_parser_scratch){0};
+
+	/* Threads are kept for all documents parsed by the context. Without
+	 * them, each document starts threads of its own
+	 */
+	context->pool = 0;
+	if ((context->options.threads > 1) && !context->options.pool) {
+		context->pool = xml_pool_create(&context->options);
+		context->options.pool = context->pool;
+	}
+	return context;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_document* xml_document_parser_parse(struct xml_document_parser* context, uint8_t* buffer, size_t length) {
+	struct xml_document* document = &context->document;
+	xml_document_parser_reset(context);
+	document->buffer.buffer = buffer;
+	if (context->options.error) {
+		context->options.error->code = XML_ERROR_NONE;
+	}
+	document->buffer.length = length;
+
+	/* Initialize parser with the scratch stacks of the previous document
+	 */
+	struct xml_parser parser = {
+		.buffer = buffer,
+		.position = 0,
+		.length = length,
+		.in_tag = false,
+
+		.partial = false,
+		.exhausted = false,
+		.token = 0,
+		.resume = {0},
+
+		.scanner = xml_scanner_select(),
+		.error = context->options.error,
+		.arena = &document->arena,
+		.symbols = &document->symbols,
+		.lazy = context->options.lazy,
+		.decode = context->options.decode,
+		.edits = &document->edits,
+		.children = {context->scratch.children.elements, 0, context->scratch.children.capacity},
+		.attributes = {context->scratch.attributes.elements, 0, context->scratch.attributes.capacity},
+
+		.frames = {context->scratch.frames.elements, 0, context->scratch.frames.capacity},
+		.max_depth = context->options.max_depth
+	};
+
+	_Bool parsed = xml_parse_document_root(&parser, document, &context->options);
+
+	/* Stacks may have grown while parsing
+	 */
+	xml_parser_scratch_keep(&context->scratch, &parser);
+
+	if (!parsed) {
+		document->root = 0;
+		return 0;
+	}
+	return document;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_document_parser_reset(struct xml_document_parser* context) {
+	struct xml_document* document = &context->document;
+
+	xml_symbols_reset(&document->symbols);
+	xml_arena_reset(&document->arena);
+	document->buffer.buffer = 0;
+	document->buffer.length = 0;
+	document->root = 0;
+	document->edits.length = 0;
+	document->error.code = XML_ERROR_NONE;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_document_parser_free(struct xml_document_parser* context) {
+	struct xml_allocator allocator = context->document.allocator;
+
+	xml_symbols_free(&context->document.symbols);
+	xml_arena_free(&context->document.arena);
+	xml_free(&allocator, context->document.edits.elements);
+
+	xml_parser_scratch_free(&allocator, &context->scratch);
+	if (context->pool) {
+		xml_pool_free(context->pool);
+	}
+	xml_free(&allocator, context);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Share of a batch owned by one of `threads' workers. The owner parses the
+ * documents `[next, end)' from the front, other workers steal the back half
+ * once their own share is done. Both bounds are protected by `lock'
+ */
+struct xml_batch_worker {
+	struct xml_batch_input const* inputs;
+	struct xml_batch_output* outputs;
+	struct xml_options options;
+	struct xml_parser_scratch scratch;
+	size_t parsed;
+	size_t stolen;
+
+	struct xml_batch_worker* workers;
+	size_t threads;
+
+	#ifdef XML_PARSER_THREADS
+	pthread_mutex_t lock;
+	#endif
+	size_t next;
+	size_t end;
+};
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * @return Monotonic time in seconds, 0 if not available
+ */
+static double xml_batch_now(void) {
+	#ifdef XML_PARSER_POSIX
+	struct timespec now;
+	if (!clock_gettime(CLOCK_MONOTONIC, &now)) {
+		return now.tv_sec + now.tv_nsec * 1e-9;
+	}
+	#endif
+	return 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ */
+static inline void xml_batch_lock(struct xml_batch_worker* worker) {
+	#ifdef XML_PARSER_THREADS
+	pthread_mutex_lock(&worker->lock);
+	#else
+	(void)worker;
+	#endif
+}
+
+static inline void xml_batch_unlock(struct xml_batch_worker* worker) {
+	#ifdef XML_PARSER_THREADS
+	pthread_mutex_unlock(&worker->lock);
+	#else
+	(void)worker;
+	#endif
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Moves the back half of `victim's share to `worker', whose own share has to
+ * be empty
+ *
+ * @return false iff `victim' has no documents left
+ */
+static _Bool xml_batch_steal(struct xml_batch_worker* worker, struct xml_batch_worker* victim) {
+	xml_batch_lock(victim);
+	size_t remaining = victim->end - victim->next;
+	size_t end = victim->end;
+	victim->end -= (remaining + 1) / 2;
+	size_t next = victim->end;
+	xml_batch_unlock(victim);
+
+	if (!remaining) {
+		return false;
+	}
+
+	xml_batch_lock(worker);
+	worker->next = next;
+	worker->end = end;
+	xml_batch_unlock(worker);
+
+	worker->stolen += end - next;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Parses documents of the worker's share until no worker has any left
+ */
+static void* xml_batch_run(void* argument) {
+	struct xml_batch_worker* worker = argument;
+	struct xml_options options = worker->options;
+
+	for (;;) {
+		xml_batch_lock(worker);
+		size_t i = worker->next;
+		_Bool own = i < worker->end;
+		if (own) {
+			worker->next++;
+		}
+		xml_batch_unlock(worker);
+
+		/* Look for work elsewhere, starting with the next worker
+		 */
+		if (!own) {
+			size_t stolen = 1;
+			for (; stolen < worker->threads; ++stolen) {
+				struct xml_batch_worker* victim = &worker->workers[(worker - worker->workers + stolen) % worker->threads];
+
+				if (xml_batch_steal(worker, victim)) {
+					break;
+				}
+			}
+			if (stolen == worker->threads) {
+				return 0;
+			}
+			continue;
+		}
+
+		struct xml_batch_output* output = &worker->outputs[i];
+		options.error = &output->error;
+
+		double start = xml_batch_now();
+		output->document = xml_parse_document_reusing(worker->inputs[i].buffer, worker->inputs[i].length, &options, &worker->scratch);
+		output->seconds = xml_batch_now() - start;
+
+		if (output->document) {
+			worker->parsed++;
+		}
+	}
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_parse_batch(struct xml_batch_input const* inputs, size_t length, struct xml_batch_output* outputs, struct xml_options const* options) {
+	struct xml_options const defaults = {0};
+	if (!options) {
+		options = &defaults;
+	}
+	struct xml_allocator allocator = xml_allocator_select(options);
+
+	size_t threads = options->threads ? options->threads : 1;
+	if (threads > length) {
+		threads = length;
+	}
+	#ifndef XML_PARSER_THREADS
+	threads = 1;
+	#endif
+
+	struct xml_batch_worker* workers = length ? xml_alloc(&allocator, threads * sizeof(struct xml_batch_worker)) : 0;
+	size_t i = 0;
+
+	/* Each worker starts with an equal share of the batch, documents are
+	 * parsed on a single thread each
+	 */
+	for (; workers && (i < threads); ++i) {
+		workers[i].inputs = inputs;
+		workers[i].outputs = outputs;
+		workers[i].options = *options;
+		workers[i].options.threads = 0;
+		workers[i].scratch = (struct xml_parser_scratch){0};
+		workers[i].parsed = 0;
+		workers[i].stolen = 0;
+		workers[i].workers = workers;
+		workers[i].threads = threads;
+		workers[i].next = i * length / threads;
+		workers[i].end = (i + 1) * length / threads;
+
+		#ifdef XML_PARSER_THREADS
+		if (pthread_mutex_init(&workers[i].lock, 0)) {
+			break;
+		}
+		#endif
+	}
+
+	/* Every document fails if the workers are not available
+	 */
+	if (!workers || (i < threads)) {
+		size_t j = 0; for (; j < length; ++j) {
+			outputs[j].document = 0;
+			outputs[j].error.code = XML_ERROR_NONE;
+			outputs[j].seconds = 0;
+			xml_error_set(&outputs[j].error, XML_ERROR_OUT_OF_MEMORY, 0, "xml_parse_batch::out of memory");
+		}
+	}
+	if (!workers) {
+		return 0;
+	}
+
+	/* Workers run on the caller's pool or on threads started for this batch
+	 * only. Should there be fewer threads than workers, the first workers
+	 * steal the shares of those not started yet. The calling thread always
+	 * takes part, so without any thread it parses the whole batch
+	 * sequentially
+	 */
+	size_t parsed = 0;
+	if (i == threads) {
+		struct xml_pool* pool = options->pool;
+		struct xml_pool* own = 0;
+		if (!pool && (threads > 1)) {
+			struct xml_options settings = *options;
+			settings.threads = threads;
+			pool = own = xml_pool_create(&settings);
+		}
+		xml_pool_run(pool, workers, sizeof(struct xml_batch_worker), threads, xml_batch_run);
+
+		size_t j = 0; for (; j < threads; ++j) {
+			parsed += workers[j].parsed;
+
+			#ifdef XML_PARSER_STATISTICS
+			xml_batch_steals += workers[j].stolen;
+			#endif
+		}
+		if (own) {
+			xml_pool_free(own);
+		}
+	}
+
+	while (i--) {
+		#ifdef XML_PARSER_THREADS
+		pthread_mutex_destroy(&workers[i].lock);
+		#endif
+		xml_parser_scratch_free(&allocator, &workers[i].scratch);
+	}
+	xml_free(&allocator, workers);
+	return parsed;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_document_memory(struct xml_document* document) {
+	return		sizeof(struct xml_document)
+		+	document->arena.used
+		+	document->symbols.slots.capacity * sizeof(struct xml_symbol*)
+		+	document->symbols.symbols.capacity * sizeof(struct xml_symbol*)
+		+	document->edits.capacity * sizeof(struct xml_node*);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_error const* xml_document_error(struct xml_document* document) {
+	return &document->error;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_node* xml_document_root(struct xml_document* document) {
+	return document->root;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ *
+ * The document's symbol table interned the node's name
+ */
+struct xml_document* xml_node_document(struct xml_node* node) {
+	return (struct xml_document*)((char*)node->name->symbols - offsetof(struct xml_document, symbols));
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_string* xml_node_name(struct xml_node* node) {
+	return &node->name->name;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_string* xml_node_content(struct xml_node* node) {
+	xml_node_load(node);
+	return node->content.buffer ? &node->content : 0;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_node_children(struct xml_node* node) {
+	return xml_node_load(node)->children_length;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_node* xml_node_child(struct xml_node* node, size_t child) {
+	if (child >= xml_node_load(node)->children_length) {
+		return 0;
+	}
+
+	return xml_node_child_array(node)[child];
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_node_attributes(struct xml_node* node) {
+	return xml_node_load(node)->attributes_length;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_string* xml_node_attribute_name(struct xml_node* node, size_t attribute) {
+	if(attribute >= xml_node_load(node)->attributes_length) {
+		return 0;
+	}
+
+	return &node->attributes[attribute].name->name;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_string* xml_node_attribute_content(struct xml_node* node, size_t attribute) {
+	if(attribute >= xml_node_load(node)->attributes_length) {
+		return 0;
+	}
+
+	return &node->attributes[attribute].content;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+uint32_t xml_document_symbol(struct xml_document* document, uint8_t const* name, size_t length) {
+	struct xml_symbol* symbol = xml_symbols_lookup(&document->symbols, name, length);
+	return symbol ? symbol->id : 0;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+uint32_t xml_node_symbol(struct xml_node* node) {
+	return node->name->id;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_node* xml_node_child_by_symbol(struct xml_node* node, uint32_t symbol) {
+	if (1 != xml_node_named_children(node, symbol)) {
+		return 0;
+	}
+	return xml_node_named_child(node, symbol, 0);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_node_named_children(struct xml_node* node, uint32_t symbol) {
+	struct xml_symbols* symbols = xml_node_load(node)->name->symbols;
+
+	if (!symbol || (symbol > symbols->symbols.length)) {
+		return 0;
+	}
+	struct xml_symbol* name = symbols->symbols.elements[symbol - 1];
+
+	/* Large nodes are looked up in their index
+	 */
+	struct xml_node_index* index = xml_node_index(node);
+	if (index) {
+		struct xml_node_index_slot* slot = xml_node_index_find(index, name);
+		return slot ? slot->length : 0;
+	}
+
+	struct xml_node** children = xml_node_child_array(node);
+	size_t named = 0;
+
+	size_t i = 0; for (; i < node->children_length; ++i) {
+		if (children[i]->name == name) {
+			named++;
+		}
+	}
+	return named;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_node* xml_node_named_child(struct xml_node* node, uint32_t symbol, size_t child) {
+	struct xml_symbols* symbols = xml_node_load(node)->name->symbols;
+
+	if (!symbol || (symbol > symbols->symbols.length)) {
+		return 0;
+	}
+	struct xml_symbol* name = symbols->symbols.elements[symbol - 1];
+
+	/* Large nodes are looked up in their index
+	 */
+	struct xml_node_index* index = xml_node_index(node);
+	if (index) {
+		struct xml_node_index_slot* slot = xml_node_index_find(index, name);
+
+		if (!slot || (child >= slot->length)) {
+			return 0;
+		}
+		return xml_node_child_array(node)[index->positions[slot->offset + child]];
+	}
+
+	struct xml_node** children = xml_node_child_array(node);
+	size_t i = 0; for (; i < node->children_length; ++i) {
+		if (children[i]->name == name) {
+			if (!child--) {
+				return children[i];
+			}
+		}
+	}
+	return 0;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_node* xml_easy_child(struct xml_node* node, uint8_t const* child_name, ...) {
+
+	/* Find children, one by one
+	 */
+	struct xml_node* current = node;
+
+	va_list arguments;
+	va_start(arguments, child_name);
+
+
+	/* Descent to current.child
+	 */
+	while (child_name) {
+
+		/* Resolve child_name once, children can then be compared by
+		 * their symbol
+		 */
+		struct xml_symbol* symbol = xml_symbols_lookup(xml_node_load(current)->name->symbols, child_name, strlen(child_name));
+		struct xml_node* next = symbol ? xml_node_child_by_symbol(current, symbol->id) : 0;
+
+		/* No unique child with that name found
+		 */
+		if (!next) {
+			va_end(arguments);
+			return 0;
+		}
+		current = next;		
+		
+		/* Find name of next child
+		 */
+		child_name = va_arg(arguments, uint8_t const*);
+	}
+	va_end(arguments);
+
+
+	/* Return current element
+	 */
+	return current;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+uint8_t* xml_easy_name(struct xml_node* node) {
+	if (!node) {
+		return 0;
+	}
+
+	return xml_string_clone(xml_node_name(node));
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+uint8_t* xml_easy_content(struct xml_node* node) {
+	if (!node) {
+		return 0;
+	}
+
+	return xml_string_clone(xml_node_content(node));
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_string_length(struct xml_string* string) {
+	if (!string) {
+		return 0;
+	}
+	return string->length;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+uint8_t const* xml_string_buffer(struct xml_string* string) {
+	if (!string || !string->length) {
+		return 0;
+	}
+	return string->buffer;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_string_copy(struct xml_string* string, uint8_t* buffer, size_t length) {
+	if (!string) {
+		return;
+	}
+
+	#define min(X,Y) ((X) < (Y) ? (X) : (Y))
+	length = min(length, string->length);
+	#undef min
+
+	memcpy(buffer, string->buffer, length);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_string_decode(struct xml_string* string, uint8_t* buffer, size_t length) {
+	if (!string) {
+		return 0;
+	}
+	return xml_decode(xml_scanner_select(), string->buffer, string->length, buffer, length);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Replaces a string of the node by a copy allocated from the document
+ *
+ * @return false iff the system is out of memory
+ */
+static _Bool xml_node_replace(struct xml_node* node, struct xml_string* string, uint8_t const* content, size_t length) {
+	struct xml_document* document = xml_node_document(node);
+	uint8_t* copy = 0;
+
+	if (length) {
+		copy = xml_arena_alloc(&document->arena, length);
+		if (!copy) {
+			return false;
+		}
+		memcpy(copy, content, length);
+	}
+
+	if (!xml_edits_push(&document->allocator, &document->edits, node)) {
+		return false;
+	}
+	string->buffer = copy ? copy : (uint8_t const*)"";
+	string->length = length;
+	return true;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+bool xml_node_set_content(struct xml_node* node, uint8_t const* content, size_t length) {
+	xml_node_load(node);
+
+	if (node->children_length) {
+		return false;
+	}
+	return xml_node_replace(node, &node->content, content, length);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+bool xml_node_set_attribute_content(struct xml_node* node, size_t attribute, uint8_t const* content, size_t length) {
+	xml_node_load(node);
+
+	if (attribute >= node->attributes_length) {
+		return false;
+	}
+	return xml_node_replace(node, &node->attributes[attribute].content, content, length);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Element whose children are being written, `child' is the next one
+ */
+struct xml_writer_frame {
+	struct xml_node* node;
+	size_t child;
+};
+
+/**
+ * [PRIVATE]
+ *
+ * Serializes a document as a sequence of chunks. Each chunk references either
+ * the document's buffer, one of its strings or a constant, so nothing is
+ * copied before the chunk reaches the `sink'. Chunks adjacent in memory are
+ * merged in `pending' first, which turns runs of unchanged siblings into a
+ * single chunk.
+ *
+ * The sink writes to `destination', whose meaning depends on the sink.
+ * `length' counts what has been handed to the sink, bytes or chunks
+ */
+struct xml_writer {
+	struct xml_document* document;
+	_Bool (*sink)(struct xml_writer* writer, uint8_t const* buffer, size_t length);
+	struct xml_string pending;
+
+	struct {
+		struct xml_writer_frame* elements;
+		size_t length;
+		size_t capacity;
+	} frames;
+
+	void* destination;
+	int descriptor;
+	size_t capacity;
+	size_t length;
+};
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Appends a chunk to the output
+ *
+ * @return false iff the sink failed
+ */
+static _Bool xml_writer_emit(struct xml_writer* writer, uint8_t const* buffer, size_t length) {
+	if (!length) {
+		return true;
+	}
+
+	if (writer->pending.length) {
+		if (&writer->pending.buffer[writer->pending.length] == buffer) {
+			writer->pending.length += length;
+			return true;
+		}
+		if (!writer->sink(writer, writer->pending.buffer, writer->pending.length)) {
+			return false;
+		}
+	}
+
+	writer->pending.buffer = buffer;
+	writer->pending.length = length;
+	return true;
+}
+
+#define xml_writer_literal(writer, literal) xml_writer_emit((writer), (uint8_t const*)(literal), sizeof(literal) - 1)
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Writes a string of a node which is written anew. Strings of decoded
+ * documents are escaped, raw strings are markup already. Within attribute
+ * values, which are always enclosed in double quotes, those are escaped as
+ * well
+ */
+static _Bool xml_writer_string(struct xml_writer* writer, struct xml_string* string, _Bool decoded, _Bool attribute) {
+	size_t start = 0;
+
+	size_t i = 0; for (; i < string->length; ++i) {
+		uint8_t character = string->buffer[i];
+		char const* entity = 0;
+
+		if (attribute && ('"' == character)) {
+			entity = "&quot;";
+		} else if (decoded && ('&' == character)) {
+			entity = "&amp;";
+		} else if (decoded && ('<' == character)) {
+			entity = "&lt;";
+		} else if (decoded && ('>' == character)) {
+			entity = "&gt;";
+		}
+
+		if (entity) {
+			if (		!xml_writer_emit(writer, &string->buffer[start], i - start)
+				||	!xml_writer_emit(writer, (uint8_t const*)entity, strlen(entity))) {
+				return false;
+			}
+			start = i + 1;
+		}
+	}
+	return xml_writer_emit(writer, &string->buffer[start], string->length - start);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Pushes a node onto the writer's frame stack
+ *
+ * @return false iff the system is out of memory
+ */
+static _Bool xml_writer_enter(struct xml_writer* writer, struct xml_node* node) {
+	if (!xml_array_reserve(&writer->document->allocator, (void**)&writer->frames.elements, &writer->frames.capacity, writer->frames.length, 1, sizeof(struct xml_writer_frame))) {
+		return false;
+	}
+	writer->frames.elements[writer->frames.length].node = node;
+	writer->frames.elements[writer->frames.length].child = 0;
+	writer->frames.length++;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Orders edits by their position within the buffer
+ */
+static int xml_writer_compare(void const* a, void const* b) {
+	uint8_t const* first = (*(struct xml_node* const*)a)->source.buffer;
+	uint8_t const* second = (*(struct xml_node* const*)b)->source.buffer;
+
+	return (first > second) - (first < second);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Finds the first changed child of `node' starting at child `first'. A child
+ * has changed iff it or one of its descendants is an edit. Edits are sorted
+ * by their position within the buffer, so the first edit behind the start of
+ * child `first' belongs to the last child starting in front of it, unless it
+ * is not within the node at all. Lazy nodes have never been accessed, so
+ * neither they nor their descendants can be edits
+ *
+ * @return Index of the child or the number of children if there is none
+ */
+static size_t xml_writer_next_changed(struct xml_writer* writer, struct xml_node* node, size_t first) {
+	struct xml_node** children = xml_node_child_array(node);
+	struct xml_node** edits = (struct xml_node**)writer->document->edits.elements;
+	uint8_t const* begin = children[first]->source.buffer;
+
+	size_t low = 0;
+	size_t high = writer->document->edits.length;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+
+		if (edits[middle]->source.buffer < begin) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if ((low == writer->document->edits.length) || (edits[low]->source.buffer >= &node->source.buffer[node->source.length])) {
+		return node->children_length;
+	}
+	uint8_t const* edit = edits[low]->source.buffer;
+
+	low = first;
+	high = node->children_length;
+	while (high - low > 1) {
+		size_t middle = low + (high - low) / 2;
+
+		if (children[middle]->source.buffer <= edit) {
+			low = middle;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Writes the opening tag of a changed node and its text content. Nodes
+ * without either children or content are closed right away
+ *
+ * @return true iff the node is still open
+ */
+static _Bool xml_writer_open(struct xml_writer* writer, struct xml_node* node, _Bool decoded, _Bool* success) {
+	*success = false;
+
+	if (		!xml_writer_literal(writer, "<")
+		||	!xml_writer_emit(writer, node->name->name.buffer, node->name->name.length)) {
+		return false;
+	}
+
+	size_t i = 0; for (; i < node->attributes_length; ++i) {
+		struct xml_string* name = &node->attributes[i].name->name;
+
+		if (		!xml_writer_literal(writer, " ")
+			||	!xml_writer_emit(writer, name->buffer, name->length)
+			||	!xml_writer_literal(writer, "=\"")
+			||	!xml_writer_string(writer, &node->attributes[i].content, decoded, true)
+			||	!xml_writer_literal(writer, "\"")) {
+			return false;
+		}
+	}
+
+	if (!node->children_length && !node->content.buffer) {
+		*success = xml_writer_literal(writer, "/>");
+		return false;
+	}
+	*success =	xml_writer_literal(writer, ">")
+		&&	xml_writer_string(writer, &node->content, decoded, false);
+	return *success;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Writes a changed node and its descendants. Unchanged descendants are
+ * written as their source. Changed ones are written anew, but the whitespace
+ * between their children is taken from the source
+ *
+ * @return false iff the sink failed or the system is out of memory
+ */
+static _Bool xml_writer_node(struct xml_writer* writer, struct xml_node* root, _Bool decoded) {
+	_Bool success;
+	if (!xml_writer_open(writer, root, decoded, &success)) {
+		return success;
+	}
+	if (!xml_writer_enter(writer, root)) {
+		return false;
+	}
+
+	while (writer->frames.length) {
+		struct xml_writer_frame* frame = &writer->frames.elements[writer->frames.length - 1];
+		struct xml_node* node = frame->node;
+		struct xml_node** children = xml_node_child_array(node);
+
+		if (frame->child < node->children_length) {
+			size_t first = frame->child;
+			uint8_t const* gap = children[first]->source.buffer;
+
+			/* Whitespace in front of the child, the first child's is
+			 * preceded by the end of its parent's opening tag
+			 */
+			if (!first) {
+				while ((gap > node->source.buffer) && xml_is_whitespace(gap[-1])) {
+					gap--;
+				}
+			} else {
+				gap = &children[first - 1]->source.buffer[children[first - 1]->source.length];
+			}
+
+			/* Unchanged children up to the next changed one are written
+			 * at once, including the whitespace between them
+			 */
+			size_t changed = xml_writer_next_changed(writer, node, first);
+			if (changed > first) {
+				struct xml_node* last = children[changed - 1];
+				frame->child = changed;
+
+				if (!xml_writer_emit(writer, gap, (size_t)(&last->source.buffer[last->source.length] - gap))) {
+					return false;
+				}
+				continue;
+			}
+
+			struct xml_node* child = children[frame->child++];
+			if (!xml_writer_emit(writer, gap, (size_t)(child->source.buffer - gap))) {
+				return false;
+			}
+
+			if (xml_writer_open(writer, child, decoded, &success)) {
+				if (!xml_writer_enter(writer, child)) {
+					return false;
+				}
+			} else if (!success) {
+				return false;
+			}
+			continue;
+		}
+
+		/* Whitespace behind the last child up to the closing tag
+		 */
+		if (node->children_length) {
+			struct xml_node* last = children[node->children_length - 1];
+			uint8_t const* gap = &last->source.buffer[last->source.length];
+			uint8_t const* end = &node->source.buffer[node->source.length];
+
+			size_t length = 0;
+			while ((&gap[length] < end) && xml_is_whitespace(gap[length])) {
+				length++;
+			}
+			if (!xml_writer_emit(writer, gap, length)) {
+				return false;
+			}
+		}
+
+		writer->frames.length--;
+		if (		!xml_writer_literal(writer, "</")
+			||	!xml_writer_emit(writer, node->name->name.buffer, node->name->name.length)
+			||	!xml_writer_literal(writer, ">")) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Writes the whole document. An unmodified document is written as its buffer,
+ * otherwise whatever surrounds the root is taken from the buffer
+ *
+ * @return false iff the sink failed or the system is out of memory
+ */
+static _Bool xml_writer_document(struct xml_writer* writer) {
+	struct xml_document* document = writer->document;
+	uint8_t const* begin = document->buffer.buffer;
+	uint8_t const* end = &begin[document->buffer.length];
+	struct xml_node* root = document->root;
+	_Bool success;
+
+	if (!document->edits.length) {
+		success = xml_writer_emit(writer, begin, document->buffer.length);
+	} else {
+		uint8_t const* tail = &root->source.buffer[root->source.length];
+
+		qsort(document->edits.elements, document->edits.length, sizeof(struct xml_node*), xml_writer_compare);
+		success =	xml_writer_emit(writer, begin, (size_t)(root->source.buffer - begin))
+			&&	xml_writer_node(writer, root, document->decode)
+			&&	xml_writer_emit(writer, tail, (size_t)(end - tail));
+	}
+	xml_free(&writer->document->allocator, writer->frames.elements);
+
+	if (success && writer->pending.length) {
+		success = writer->sink(writer, writer->pending.buffer, writer->pending.length);
+	}
+	return success;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Sinks of xml_document_write and xml_document_write_buffer, the latter
+ * writes as much as fits but counts everything
+ */
+static _Bool xml_writer_file(struct xml_writer* writer, uint8_t const* buffer, size_t length) {
+	writer->length += length;
+	return fwrite(buffer, sizeof(uint8_t), length, writer->destination) == length;
+}
+
+static _Bool xml_writer_buffer(struct xml_writer* writer, uint8_t const* buffer, size_t length) {
+	if (writer->length < writer->capacity) {
+		size_t available = writer->capacity - writer->length;
+		memcpy((uint8_t*)writer->destination + writer->length, buffer, (length < available) ? length : available);
+	}
+	writer->length += length;
+	return true;
+}
+
+
+
+#ifdef XML_PARSER_POSIX
+/**
+ * [PRIVATE]
+ *
+ * Sink of xml_document_iovec, stores as many chunks as fit but counts all
+ */
+static _Bool xml_writer_iovec(struct xml_writer* writer, uint8_t const* buffer, size_t length) {
+	if (writer->length < writer->capacity) {
+		struct iovec* iovec = &((struct iovec*)writer->destination)[writer->length];
+		iovec->iov_base = (void*)buffer;
+		iovec->iov_len = length;
+	}
+	writer->length++;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Writes all chunks collected so far to the writer's descriptor, continuing
+ * after partial writes and interrupts
+ *
+ * @return false iff writing failed
+ */
+static _Bool xml_writer_writev(struct xml_writer* writer) {
+	struct iovec* iovecs = writer->destination;
+	size_t length = writer->length;
+
+	while (length) {
+		ssize_t written = writev(writer->descriptor, iovecs, (int)length);
+
+		if (written < 0) {
+			if (EINTR == errno) {
+				continue;
+			}
+			return false;
+		}
+
+		for (; length && ((size_t)written >= iovecs->iov_len); ++iovecs, --length) {
+			written -= (ssize_t)iovecs->iov_len;
+		}
+		if (length) {
+			iovecs->iov_base = (uint8_t*)iovecs->iov_base + written;
+			iovecs->iov_len -= (size_t)written;
+		}
+	}
+
+	writer->length = 0;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Sink of xml_document_write_fd, collects chunks for a single writev call
+ */
+static _Bool xml_writer_descriptor(struct xml_writer* writer, uint8_t const* buffer, size_t length) {
+	if ((writer->length == writer->capacity) && !xml_writer_writev(writer)) {
+		return false;
+	}
+	return xml_writer_iovec(writer, buffer, length);
+}
+#endif
+
+
+
+/**
+ * [PUBLIC API]
+ */
+bool xml_document_write(struct xml_document* document, FILE* destination) {
+	struct xml_writer writer = {
+		.document = document,
+		.sink = xml_writer_file,
+		.pending = {0},
+		.frames = {0},
+
+		.destination = destination,
+		.descriptor = -1,
+		.capacity = 0,
+		.length = 0
+	};
+	return xml_writer_document(&writer);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+bool xml_document_write_fd(struct xml_document* document, int descriptor) {
+
+	/* Without POSIX, there is no writev
+	 */
+	#ifndef XML_PARSER_POSIX
+	(void)document;
+	(void)descriptor;
+	return false;
+
+	#else
+	struct iovec iovecs[XML_WRITER_IOVECS];
+
+	struct xml_writer writer = {
+		.document = document,
+		.sink = xml_writer_descriptor,
+		.pending = {0},
+		.frames = {0},
+
+		.destination = iovecs,
+		.descriptor = descriptor,
+		.capacity = XML_WRITER_IOVECS,
+		.length = 0
+	};
+	return xml_writer_document(&writer) && xml_writer_writev(&writer);
+	#endif
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_document_write_buffer(struct xml_document* document, uint8_t* buffer, size_t length) {
+	struct xml_writer writer = {
+		.document = document,
+		.sink = xml_writer_buffer,
+		.pending = {0},
+		.frames = {0},
+
+		.destination = buffer,
+		.descriptor = -1,
+		.capacity = length,
+		.length = 0
+	};
+	return xml_writer_document(&writer) ? writer.length : 0;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+size_t xml_document_iovec(struct xml_document* document, struct iovec* iovecs, size_t capacity) {
+	#ifndef XML_PARSER_POSIX
+	(void)document;
+	(void)iovecs;
+	(void)capacity;
+	return 0;
+
+	#else
+	struct xml_writer writer = {
+		.document = document,
+		.sink = xml_writer_iovec,
+		.pending = {0},
+		.frames = {0},
+
+		.destination = iovecs,
+		.descriptor = -1,
+		.capacity = capacity,
+		.length = 0
+	};
+	return xml_writer_document(&writer) ? writer.length : 0;
+	#endif
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Condition on the elements selected by a query step. Attribute predicates
+ * require an attribute `name', whose content has to equal `value' unless its
+ * buffer is 0. Position predicates select the `position'-th element among
+ * its siblings passing all preceding predicates, which are counted by the
+ * query iterator's counter `counter'
+ */
+struct xml_query_predicate {
+	struct xml_string name;
+	struct xml_string value;
+	size_t position;
+	size_t counter;
+};
+
+/**
+ * [PRIVATE]
+ *
+ * Location step of a query, selecting children or, if `descendant', all
+ * descendants of the elements selected by the previous step. Selected
+ * elements have the given `name' unless its length is 0 and satisfy the
+ * predicates `[first, first + length)'
+ */
+struct xml_query_step {
+	struct xml_string name;
+	_Bool descendant;
+
+	struct {
+		size_t first;
+		size_t length;
+	} predicates;
+};
+
+/**
+ * [OPAQUE API]
+ *
+ * A compiled query is a nondeterministic automaton with one state per step,
+ * the names of its steps and predicates reference the copied `expression'.
+ * Relative queries start at the children of the node they are run against,
+ * `absolute' ones at the node itself. The query's memory is owned by
+ * `allocator'
+ */
+struct xml_query {
+	struct xml_allocator allocator;
+	uint8_t* expression;
+	_Bool absolute;
+
+	struct {
+		struct xml_query_step* elements;
+		size_t length;
+		size_t capacity;
+	} steps;
+
+	struct {
+		struct xml_query_predicate* elements;
+		size_t length;
+		size_t capacity;
+	} predicates;
+};
+
+/**
+ * [PRIVATE]
+ *
+ * Element whose children are being matched. `expected' has a bit set for
+ * every step the children may match, `child' is the next one to match
+ */
+struct xml_query_frame {
+	struct xml_node* node;
+	size_t child;
+	uint64_t expected;
+};
+
+/**
+ * [OPAQUE API]
+ *
+ * Walks the tree in document order, only descending into elements expecting
+ * further steps. Each frame has its own position counters, which are stored
+ * at `counters[depth * query->predicates.length]'. Names are compared by
+ * string until the first match, afterwards `symbols' allows to compare by
+ * symbol. Those of steps come first, followed by those of predicates
+ */
+struct xml_query_iterator {
+	struct xml_query const* query;
+	struct xml_node* context;
+	struct xml_allocator const* allocator;
+	struct xml_symbol** symbols;
+
+	struct {
+		struct xml_query_frame* elements;
+		size_t length;
+		size_t capacity;
+	} frames;
+
+	struct {
+		size_t* elements;
+		size_t capacity;
+	} counters;
+};
+
+/**
+ * [PRIVATE]
+ *
+ * Queries are automata with one bit of state per step
+ */
+#define XML_QUERY_MAXIMUM_STEPS 64
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Reads a name within a query, names end at markup of the query language
+ *
+ * @return false iff there is no name at `position'
+ */
+static _Bool xml_query_name(uint8_t* expression, size_t* position, struct xml_string* name) {
+	size_t start = *position;
+
+	while (expression[*position] && !strchr("/[]@='\"", expression[*position]) && !xml_is_whitespace(expression[*position])) {
+		(*position)++;
+	}
+
+	name->buffer = &expression[start];
+	name->length = *position - start;
+	return name->length > 0;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Reads a predicate following its `['
+ *
+ * ---( Example )---
+ * [@type='x']
+ * [@id]
+ * [2]
+ * ---
+ *
+ * @return false iff the predicate is malformed or the system is out of
+ *     memory
+ */
+static _Bool xml_query_predicate(struct xml_query* query, size_t* position) {
+	uint8_t* expression = query->expression;
+
+	if (!xml_array_reserve(&query->allocator, (void**)&query->predicates.elements, &query->predicates.capacity, query->predicates.length, 1, sizeof(struct xml_query_predicate))) {
+		return false;
+	}
+	struct xml_query_predicate* predicate = &query->predicates.elements[query->predicates.length];
+	predicate->name = (struct xml_string){0};
+	predicate->value = (struct xml_string){0};
+	predicate->position = 0;
+	predicate->counter = query->predicates.length;
+
+	/* Attribute with optional value in single or double quotes
+	 */
+	if ('@' == expression[*position]) {
+		(*position)++;
+
+		if (!xml_query_name(expression, position, &predicate->name)) {
+			return false;
+		}
+
+		if ('=' == expression[*position]) {
+			uint8_t quote = expression[++(*position)];
+			if (('\'' != quote) && ('"' != quote)) {
+				return false;
+			}
+
+			uint8_t* end = (uint8_t*)strchr((char*)&expression[*position + 1], quote);
+			if (!end) {
+				return false;
+			}
+			predicate->value.buffer = &expression[*position + 1];
+			predicate->value.length = (size_t)(end - predicate->value.buffer);
+			*position = (size_t)(end - expression) + 1;
+		}
+
+	/* Position starting at 1
+	 */
+	} else {
+		while (('0' <= expression[*position]) && (expression[*position] <= '9')) {
+			if (predicate->position > (SIZE_MAX - 9) / 10) {
+				return false;
+			}
+			predicate->position = 10 * predicate->position + (expression[(*position)++] - '0');
+		}
+		if (!predicate->position) {
+			return false;
+		}
+	}
+
+	if (']' != expression[*position]) {
+		return false;
+	}
+	(*position)++;
+	query->predicates.length++;
+	return true;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_query* xml_query_compile(char const* expression) {
+	return xml_query_compile_ex(expression, 0);
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_query* xml_query_compile_ex(char const* expression, struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
+
+	struct xml_query* query = xml_alloc(&allocator, sizeof(struct xml_query));
+	if (!query) {
+		return 0;
+	}
+	memset(query, 0, sizeof(struct xml_query));
+	query->allocator = allocator;
+
+	size_t length = strlen(expression);
+	query->expression = xml_alloc(&allocator, length + 1);
+	if (!query->expression) {
+		xml_query_free(query);
+		return 0;
+	}
+	memcpy(query->expression, expression, length + 1);
+	query->absolute = ('/' == expression[0]);
+
+	size_t position = 0;
+	while (!query->steps.length || (position < length)) {
+		if (		(query->steps.length == XML_QUERY_MAXIMUM_STEPS)
+			||	!xml_array_reserve(&query->allocator, (void**)&query->steps.elements, &query->steps.capacity, query->steps.length, 1, sizeof(struct xml_query_step))) {
+			xml_query_free(query);
+			return 0;
+		}
+		struct xml_query_step* step = &query->steps.elements[query->steps.length++];
+		step->descendant = false;
+
+		/* Steps are separated by `/' or `//', only the first one of a
+		 * relative query has none
+		 */
+		if ('/' == query->expression[position]) {
+			position++;
+
+			if ('/' == query->expression[position]) {
+				step->descendant = true;
+				position++;
+			}
+		} else if (query->steps.length > 1) {
+			xml_query_free(query);
+			return 0;
+		}
+
+		/* Name test, `*' matches any name
+		 */
+		if ('*' == query->expression[position]) {
+			step->name.buffer = &query->expression[position++];
+			step->name.length = 0;
+		} else if (!xml_query_name(query->expression, &position, &step->name)) {
+			xml_query_free(query);
+			return 0;
+		}
+
+		step->predicates.first = query->predicates.length;
+		while ('[' == query->expression[position]) {
+			position++;
+
+			if (!xml_query_predicate(query, &position)) {
+				xml_query_free(query);
+				return 0;
+			}
+		}
+		step->predicates.length = query->predicates.length - step->predicates.first;
+	}
+
+	return query;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_query_free(struct xml_query* query) {
+	if (!query) {
+		return;
+	}
+	struct xml_allocator allocator = query->allocator;
+
+	xml_free(&allocator, query->expression);
+	xml_free(&allocator, query->steps.elements);
+	xml_free(&allocator, query->predicates.elements);
+	xml_free(&allocator, query);
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Compares a name of the query with the name of an element or attribute,
+ * remembering the symbol once the name has been found
+ *
+ * @return true iff the names are equal
+ */
+static _Bool xml_query_symbol(struct xml_symbol** symbol, struct xml_string* name, struct xml_symbol* candidate) {
+	if (*symbol) {
+		return *symbol == candidate;
+	}
+
+	if (!xml_string_equals(&candidate->name, name)) {
+		return false;
+	}
+	*symbol = candidate;
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Tests an element against a step. Position predicates count the element
+ * using the counters of its parent's frame
+ *
+ * @return true iff the step selects the element
+ */
+static _Bool xml_query_match(struct xml_query_iterator* iterator, size_t s, struct xml_node* node, size_t* counters) {
+	struct xml_query const* query = iterator->query;
+	struct xml_query_step const* step = &query->steps.elements[s];
+
+	if (step->name.length && !xml_query_symbol(&iterator->symbols[s], (struct xml_string*)&step->name, node->name)) {
+		return false;
+	}
+
+	size_t p = step->predicates.first; for (; p < step->predicates.first + step->predicates.length; ++p) {
+		struct xml_query_predicate const* predicate = &query->predicates.elements[p];
+
+		if (predicate->position) {
+			if (++counters[predicate->counter] != predicate->position) {
+				return false;
+			}
+			continue;
+		}
+
+		/* Attribute predicates need the element to be materialized
+		 */
+		xml_node_load(node);
+		struct xml_symbol** symbol = &iterator->symbols[query->steps.length + p];
+
+		size_t i = 0; while ((i < node->attributes_length) && !xml_query_symbol(symbol, (struct xml_string*)&predicate->name, node->attributes[i].name)) {
+			i++;
+		}
+		if (i == node->attributes_length) {
+			return false;
+		}
+		if (predicate->value.buffer && !xml_string_equals(&node->attributes[i].content, (struct xml_string*)&predicate->value)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Starts matching the children of `node', or the context node itself if
+ * `node' is 0, with fresh position counters
+ *
+ * @return false iff the system is out of memory
+ */
+static _Bool xml_query_enter(struct xml_query_iterator* iterator, struct xml_node* node, uint64_t expected) {
+	size_t counters = iterator->query->predicates.length;
+	size_t depth = iterator->frames.length;
+
+	if (		!xml_array_reserve(iterator->allocator, (void**)&iterator->frames.elements, &iterator->frames.capacity, depth, 1, sizeof(struct xml_query_frame))
+		||	!xml_array_reserve(iterator->allocator, (void**)&iterator->counters.elements, &iterator->counters.capacity, depth * counters, counters, sizeof(size_t))) {
+		return false;
+	}
+
+	iterator->frames.elements[depth].node = node;
+	iterator->frames.elements[depth].child = 0;
+	iterator->frames.elements[depth].expected = expected;
+	iterator->frames.length++;
+
+	if (counters) {
+		memset(&iterator->counters.elements[depth * counters], 0, counters * sizeof(size_t));
+	}
+	return true;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_query_iterator* xml_query_iterate(struct xml_query const* query, struct xml_node* node) {
+	struct xml_allocator const* allocator = &xml_node_document(node)->allocator;
+	struct xml_query_iterator* iterator = xml_alloc(allocator, sizeof(struct xml_query_iterator));
+	if (!iterator) {
+		return 0;
+	}
+	memset(iterator, 0, sizeof(struct xml_query_iterator));
+	iterator->query = query;
+	iterator->context = node;
+	iterator->allocator = allocator;
+
+	size_t symbols = query->steps.length + query->predicates.length;
+	iterator->symbols = xml_alloc(allocator, symbols * sizeof(struct xml_symbol*));
+	if (iterator->symbols) {
+		memset(iterator->symbols, 0, symbols * sizeof(struct xml_symbol*));
+	}
+
+	if (!iterator->symbols || !xml_query_enter(iterator, query->absolute ? 0 : node, 1)) {
+		xml_query_iterator_free(iterator);
+		return 0;
+	}
+	return iterator;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+struct xml_node* xml_query_next(struct xml_query_iterator* iterator) {
+	struct xml_query const* query = iterator->query;
+
+	while (iterator->frames.length) {
+		size_t depth = iterator->frames.length - 1;
+		struct xml_query_frame* frame = &iterator->frames.elements[depth];
+
+		/* Absolute queries start at a virtual parent of the context node
+		 */
+		size_t children = frame->node ? xml_node_children(frame->node) : 1;
+		if (frame->child >= children) {
+			iterator->frames.length--;
+			continue;
+		}
+		struct xml_node* child = frame->node ? xml_node_child(frame->node, frame->child) : iterator->context;
+		frame->child++;
+
+		/* Descendant steps stay expected below the child, matched steps
+		 * make the child a result or expect the next step
+		 */
+		uint64_t expected = 0;
+		_Bool result = false;
+
+		size_t s = 0; for (; s < query->steps.length; ++s) {
+			if (!(frame->expected & ((uint64_t)1 << s))) {
+				continue;
+			}
+			if (query->steps.elements[s].descendant) {
+				expected |= (uint64_t)1 << s;
+			}
+			if (xml_query_match(iterator, s, child, &iterator->counters.elements[depth * query->predicates.length])) {
+				if (s + 1 == query->steps.length) {
+					result = true;
+				} else {
+					expected |= (uint64_t)1 << (s + 1);
+				}
+			}
+		}
+
+		if (expected && !xml_query_enter(iterator, child, expected)) {
+			iterator->frames.length = 0;
+			return 0;
+		}
+		if (result) {
+			return child;
+		}
+	}
+	return 0;
+}
+
+
+
+/**
+ * [PUBLIC API]
+ */
+void xml_query_iterator_free(struct xml_query_iterator* iterator) {
+	if (!iterator) {
+		return;
+	}
+	xml_free(iterator->allocator, iterator->symbols);
+	xml_free(iterator->allocator, iterator->frames.elements);
+	xml_free(iterator->allocator, iterator->counters.elements);
+	xml_free(iterator->allocator, iterator);
 }
 
 
 
 /**
  * [PRIVATE]
- * 
- * Parses an XML fragment node
  *
- * ---( Example without children )---
- * <Node>Text</Node>
- * ---
+ * Copies the name of an opened element onto the stack
  *
- * ---( Example with children )---
- * <Parent>
- *     <Child>Text</Child>
- *     <Child>Text</Child>
- *     <Test>Content</Test>
- * </Parent>
- * ---
+ * @return false iff the system is out of memory
  */
-static struct xml_node* xml_parse_node(struct xml_parser* parser) {
-	xml_parser_info(parser, "node");
+static _Bool xml_reader_push(struct xml_reader* reader, struct xml_string* name) {
+	if (		!xml_array_reserve(&reader->allocator, (void**)&reader->open.elements, &reader->open.capacity, reader->open.length, 1, sizeof(size_t))
+		||	!xml_array_reserve(&reader->allocator, (void**)&reader->names.buffer, &reader->names.capacity, reader->names.length, name->length, sizeof(uint8_t))) {
+		return false;
+	}
 
-	/* Setup variables
-	 */
-	struct xml_string* tag_open = 0;
-	struct xml_string* tag_close = 0;
-	struct xml_string* content = 0;
+	reader->open.elements[reader->open.length++] = reader->names.length;
+	memcpy(&reader->names.buffer[reader->names.length], name->buffer, name->length);
+	reader->names.length += name->length;
+	return true;
+}
 
-	size_t original_length;
-	struct xml_attribute** attributes;
 
-	struct xml_node** children = calloc(1, sizeof(struct xml_node*));
-	children[0] = 0;
 
+/**
+ * [PRIVATE]
+ *
+ * @return Name of the innermost open element
+ */
+static struct xml_string xml_reader_top(struct xml_reader* reader) {
+	size_t start = reader->open.elements[reader->open.length - 1];
 
-	/* Parse open tag
-	 */
-	tag_open = xml_parse_tag_open(parser);
-	if (!tag_open) {
-		xml_parser_error(parser, NO_CHARACTER, "xml_parse_node::tag_open");
-		goto exit_failure;
+	struct xml_string name = {
+		.buffer = &reader->names.buffer[start],
+		.length = reader->names.length - start
+	};
+	return name;
+}
+
+
+
+/**
+ * [PRIVATE]
+ *
+ * Completes the reader's error with the names of all open elements
+ */
+static void xml_reader_error_path(struct xml_reader* reader) {
+	if (XML_ERROR_NONE == reader->error.code) {
+		return;
 	}
 
-	original_length = tag_open->length;
-	attributes = xml_find_attributes(parser, tag_open);
+	size_t i = 0; for (; i < reader->open.length; ++i) {
+		size_t start = reader->open.elements[i];
+		size_t end = (i + 1 < reader->open.length) ? reader->open.elements[i + 1] : reader->names.length;
 
-	/* If tag ends with `/' it's self closing, skip content lookup */
-	if (tag_open->length > 0 && '/' == tag_open->buffer[original_length - 1]) {
-		/* Drop `/'
-		 */
-		goto node_creation;
+		xml_error_path(&reader->error, &reader->names.buffer[start], end - start);
 	}
+}
 
-	/* If the content does not start with '<', a text content is assumed
-	 */
-	if ('<' != xml_parser_peek(parser, CURRENT_CHARACTER)) {
-		content = xml_parse_content(parser);
 
-		if (!content) {
-			xml_parser_error(parser, 0, "xml_parse_node::content");
-			goto exit_failure;
-		}
 
+/**
+ * [PRIVATE]
+ *
+ * Prepares the reader for a new document
+ */
+static void xml_reader_reset(struct xml_reader* reader) {
+	reader->state = XML_PARSER_EXPECT_ROOT;
+	reader->in_tag = false;
+	reader->names.length = 0;
+	reader->open.length = 0;
+}
 
-	/* Otherwise children are to be expected
-	 */
-	} else while ('/' != xml_parser_peek(parser, NEXT_CHARACTER)) {
 
-		/* Parse child node
-		 */
-		struct xml_node* child = xml_parse_node(parser);
-		if (!child) {
-			xml_parser_error(parser, NEXT_CHARACTER, "xml_parse_node::child");
-			goto exit_failure;
-		}
 
-		/* Grow child array :)
-		 */
-		size_t old_elements = get_zero_terminated_array_nodes(children);
-		size_t new_elements = old_elements + 1;
-		children = realloc(children, (new_elements + 1) * sizeof(struct xml_node*));
+/**
+ * [PRIVATE]
+ *
+ * Reads tokens from the parser and reports them to the reader's callbacks
+ * until the document is complete. If the parser's buffer is partial, reading
+ * stops in front of the first incomplete token with the reader's state
+ * describing where to continue
+ */
+static enum xml_reader_result xml_reader_run(struct xml_reader* reader, struct xml_parser* parser) {
+	struct xml_reader_callbacks const* callbacks = &reader->callbacks;
+	void* context = reader->context;
+	struct xml_token token;
 
-		/* Save child
-		 */
-		children[new_elements - 1] = child;
-		children[new_elements] = 0;
-	}
+	parser->in_tag = reader->in_tag;
 
+	while (XML_PARSER_DONE != reader->state) {
+		xml_lexer_next(parser, &token);
 
-	/* Parse close tag
-	 */
-	tag_close = xml_parse_tag_close(parser);
-	if (!tag_close) {
-		xml_parser_error(parser, NO_CHARACTER, "xml_parse_node::tag_close");
-		goto exit_failure;
-	}
+		/* Wait for more input, the token will be read again
+		 */
+		if (parser->partial && parser->exhausted) {
+			parser->position = parser->token;
+			parser->in_tag = reader->in_tag;
+			return XML_READER_SUCCESS;
+		}
+		reader->in_tag = parser->in_tag;
+
+		switch (token.type) {
+
+			/* Element starts, attributes will follow
+			 */
+			case XML_TOKEN_TAG_OPEN:
+				if (		(XML_PARSER_EXPECT_ROOT != reader->state)
+					&&	(XML_PARSER_EXPECT_CONTENT != reader->state)
+					&&	(XML_PARSER_EXPECT_CHILD != reader->state)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_reader_parse::unexpected opening tag");
+					return XML_READER_ERROR;
+				}
+				if (!xml_reader_push(reader, &token.name)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_OUT_OF_MEMORY, "xml_reader_parse::out of memory");
+					return XML_READER_ERROR;
+				}
+				reader->state = XML_PARSER_EXPECT_ATTRIBUTE;
 
+				if (callbacks->start_element && !callbacks->start_element(context, &token.name)) {
+					return XML_READER_ABORTED;
+				}
+				break;
 
-	/* Close tag has to match open tag
-	 */
-	if (!xml_string_equals(tag_open, tag_close)) {
-		xml_parser_error(parser, NO_CHARACTER, "xml_parse_node::tag missmatch");
-		goto exit_failure;
-	}
+			case XML_TOKEN_ATTRIBUTE:
+				if (callbacks->attribute && !callbacks->attribute(context, &token.name, &token.content)) {
+					return XML_READER_ABORTED;
+				}
+				break;
+
+			case XML_TOKEN_TAG_END:
+				reader->state = XML_PARSER_EXPECT_CONTENT;
+				break;
+
+			/* Text content has to be followed by the closing tag
+			 */
+			case XML_TOKEN_TEXT:
+				if (XML_PARSER_EXPECT_CONTENT != reader->state) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_reader_parse::unexpected text");
+					return XML_READER_ERROR;
+				}
+				reader->state = XML_PARSER_EXPECT_CLOSE;
 
+				if (callbacks->text && !callbacks->text(context, &token.content)) {
+					return XML_READER_ABORTED;
+				}
+				break;
+
+			/* Element ends, closing tag has to match opening tag
+			 */
+			case XML_TOKEN_TAG_CLOSE: {
+				if ((XML_PARSER_EXPECT_ROOT == reader->state) || (XML_PARSER_EXPECT_ATTRIBUTE == reader->state)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_SYNTAX, "xml_reader_parse::unexpected closing tag");
+					return XML_READER_ERROR;
+				}
+				struct xml_string open = xml_reader_top(reader);
 
-	/* Return parsed node
-	 */
-	xml_string_free(tag_close);
+				if (!xml_string_equals(&open, &token.name)) {
+					xml_parser_error(parser, NO_CHARACTER, XML_ERROR_TAG_MISMATCH, "xml_reader_parse::tag missmatch");
+					return XML_READER_ERROR;
+				}
+			}
+				/* Fall through */
 
-node_creation:;
-	struct xml_node* node = malloc(sizeof(struct xml_node));
-	node->name = tag_open;
-	node->content = content;
-	node->attributes = attributes;
-	node->children = children;
-	return node;
+			case XML_TOKEN_TAG_EMPTY: {
+				struct xml_string name = xml_reader_top(reader);
 
+				reader->names.length = reader->open.elements[--reader->open.length];
+				reader->state = reader->open.length ? XML_PARSER_EXPECT_CHILD : XML_PARSER_DONE;
 
-	/* A failure occured, so free all allocalted resources
-	 */
-exit_failure:
-	if (tag_open) {
-		xml_string_free(tag_open);
-	}
-	if (tag_close) {
-		xml_string_free(tag_close);
-	}
-	if (content) {
-		xml_string_free(content);
-	}
+				if (callbacks->end_element && !callbacks->end_element(context, &name)) {
+					return XML_READER_ABORTED;
+				}
+				break;
+			}
 
-	struct xml_node** it = children;
-	while (*it) {
-		xml_node_free(*it);
-		++it;
+			case XML_TOKEN_END:
+				xml_parser_error(parser, NO_CHARACTER, XML_ERROR_UNEXPECTED_END, "xml_reader_parse::unexpected end of document");
+				return XML_READER_ERROR;
+
+			case XML_TOKEN_ERROR:
+				return XML_READER_ERROR;
+		}
 	}
-	free(children);
 
-	return 0;
+	return XML_READER_SUCCESS;
 }
 
 
 
-
-
 /**
- * [PUBLIC API]
+ * [PRIVATE]
+ *
+ * Prepares a parser for reading `buffer' without building a tree, so neither
+ * arena nor scratch stacks are necessary
  */
-struct xml_document* xml_parse_document(uint8_t* buffer, size_t length) {
-
-	/* Initialize parser
-	 */
-	struct xml_parser parser = {
+static void xml_reader_parser(struct xml_parser* parser, uint8_t* buffer, size_t length, _Bool partial, struct xml_error* error) {
+	struct xml_parser initialized = {
 		.buffer = buffer,
 		.position = 0,
-		.length = length
+		.length = length,
+		.in_tag = false,
+
+		.partial = partial,
+		.exhausted = false,
+		.token = 0,
+		.resume = {0},
+
+		.scanner = xml_scanner_select(),
+		.error = error,
+		.arena = 0,
+		.symbols = 0,
+		.lazy = false,
+		.decode = false,
+		.edits = 0,
+		.children = {0},
+		.attributes = {0},
+
+		.frames = {0},
+		.max_depth = 0
 	};
-
-	/* An empty buffer can never contain a valid document
-	 */
-	if (!length) {
-		xml_parser_error(&parser, NO_CHARACTER, "xml_parse_document::length equals zero");
-		return 0;
-	}
-
-	/* Parse the root node
-	 */
-	struct xml_node* root = xml_parse_node(&parser);
-	if (!root) {
-		xml_parser_error(&parser, NO_CHARACTER, "xml_parse_document::parsing document failed");
-		return 0;
-	}
-
-	/* Return parsed document
-	 */
-	struct xml_document* document = malloc(sizeof(struct xml_document));
-	document->buffer.buffer = buffer;
-	document->buffer.length = length;
-	document->root = root;
-
-	return document;
+	*parser = initialized;
 }
 
 
@@ -864,46 +5835,30 @@ struct xml_document* xml_parse_document(uint8_t* buffer, size_t length) {
 /**
  * [PUBLIC API]
  */
-struct xml_document* xml_open_document(FILE* source) {
-
-	/* Prepare buffer
-	 */
-	size_t const read_chunk = 1; // TODO 4096;
-
-	size_t document_length = 0;
-	size_t buffer_size = 1;	// TODO 4069
-	uint8_t* buffer = malloc(buffer_size * sizeof(uint8_t));
+struct xml_reader* xml_reader_create(struct xml_reader_callbacks const* callbacks, void* context) {
+	return xml_reader_create_ex(callbacks, context, 0);
+}
 
-	/* Read hole file into buffer
-	 */
-	while (!feof(source)) {
 
-		/* Reallocate buffer
-		 */
-		if (buffer_size - document_length < read_chunk) {
-			buffer = realloc(buffer, buffer_size + 2 * read_chunk);
-			buffer_size += 2 * read_chunk;
-		}
 
-		size_t read = fread(
-			&buffer[document_length],
-			sizeof(uint8_t), read_chunk,
-			source
-		);
+/**
+ * [PUBLIC API]
+ */
+struct xml_reader* xml_reader_create_ex(struct xml_reader_callbacks const* callbacks, void* context, struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
 
-		document_length += read;
+	struct xml_reader* reader = xml_alloc(&allocator, sizeof(struct xml_reader));
+	if (!reader) {
+		return 0;
 	}
-	fclose(source);
+	memset(reader, 0, sizeof(struct xml_reader));
 
-	/* Try to parse buffer
-	 */
-	struct xml_document* document = xml_parse_document(buffer, document_length);
+	reader->callbacks = *callbacks;
+	reader->context = context;
+	reader->allocator = allocator;
+	xml_reader_reset(reader);
 
-	if (!document) {
-		free(buffer);
-		return 0;
-	}
-	return document;
+	return reader;
 }
 
 
@@ -911,13 +5866,18 @@ struct xml_document* xml_open_document(FILE* source) {
 /**
  * [PUBLIC API]
  */
-void xml_document_free(struct xml_document* document, bool free_buffer) {
-	xml_node_free(document->root);
+enum xml_reader_result xml_reader_parse(struct xml_reader* reader, uint8_t* buffer, size_t length) {
+	struct xml_parser parser;
+	xml_reader_parser(&parser, buffer, length, false, &reader->error);
 
-	if (free_buffer) {
-		free(document->buffer.buffer);
+	xml_reader_reset(reader);
+	reader->error.code = XML_ERROR_NONE;
+
+	enum xml_reader_result result = xml_reader_run(reader, &parser);
+	if (XML_READER_ERROR == result) {
+		xml_reader_error_path(reader);
 	}
-	free(document);
+	return result;
 }
 
 
@@ -925,8 +5885,8 @@ void xml_document_free(struct xml_document* document, bool free_buffer) {
 /**
  * [PUBLIC API]
  */
-struct xml_node* xml_document_root(struct xml_document* document) {
-	return document->root;
+struct xml_error const* xml_reader_error(struct xml_reader* reader) {
+	return &reader->error;
 }
 
 
@@ -934,8 +5894,12 @@ struct xml_node* xml_document_root(struct xml_document* document) {
 /**
  * [PUBLIC API]
  */
-struct xml_string* xml_node_name(struct xml_node* node) {
-	return node->name;
+void xml_reader_free(struct xml_reader* reader) {
+	struct xml_allocator allocator = reader->allocator;
+
+	xml_free(&allocator, reader->names.buffer);
+	xml_free(&allocator, reader->open.elements);
+	xml_free(&allocator, reader);
 }
 
 
@@ -943,41 +5907,104 @@ struct xml_string* xml_node_name(struct xml_node* node) {
 /**
  * [PUBLIC API]
  */
-struct xml_string* xml_node_content(struct xml_node* node) {
-	return node->content;
+bool xml_validate(uint8_t const* buffer, size_t length, struct xml_error* error) {
+	struct xml_reader reader = {0};
+	reader.allocator = xml_allocator_default;
+	xml_reader_reset(&reader);
+
+	if (!length) {
+		xml_error_set(&reader.error, XML_ERROR_EMPTY_DOCUMENT, 0, "xml_validate::length equals zero");
+
+	/* A reader without callbacks, the buffer is never modified since
+	 * references are not decoded
+	 */
+	} else {
+		struct xml_parser parser;
+		xml_reader_parser(&parser, (uint8_t*)buffer, length, false, &reader.error);
+
+		if (XML_READER_SUCCESS != xml_reader_run(&reader, &parser)) {
+			xml_error_set(&reader.error, XML_ERROR_SYNTAX, parser.position, "xml_validate::malformed document");
+			xml_reader_error_path(&reader);
+		}
+		xml_free(&reader.allocator, reader.names.buffer);
+		xml_free(&reader.allocator, reader.open.elements);
+	}
+
+	if (error) {
+		*error = reader.error;
+	}
+	return XML_ERROR_NONE == reader.error.code;
 }
 
 
 
 /**
- * [PUBLIC API]
+ * [OPAQUE API]
  *
- * @warning O(n)
+ * An xml_push_parser is an xml_reader which keeps the input not yet consumed
+ * by the lexer, i.e. an incomplete token at the end of the last chunk.
+ * `consumed' counts the bytes of the document already dropped from the input
  */
-size_t xml_node_children(struct xml_node* node) {
-	return get_zero_terminated_array_nodes(node->children);
-}
+struct xml_push_parser {
+	struct xml_reader reader;
+	enum xml_reader_result result;
+	size_t consumed;
+
+	struct {
+		uint8_t* buffer;
+		size_t length;
+		size_t capacity;
+	} input;
+
+	struct {
+		size_t position;
+		size_t searched;
+		int byte;
+	} resume;
+};
 
 
 
 /**
- * [PUBLIC API]
+ * [PRIVATE]
+ *
+ * Runs the reader on all input received so far and drops what has been
+ * consumed
  */
-struct xml_node* xml_node_child(struct xml_node* node, size_t child) {
-	if (child >= xml_node_children(node)) {
-		return 0;
+static enum xml_reader_result xml_push_parser_run(struct xml_push_parser* push_parser, _Bool partial) {
+	struct xml_parser parser;
+	xml_reader_parser(&parser, push_parser->input.buffer, push_parser->input.length, partial, &push_parser->reader.error);
+	parser.resume.position = push_parser->resume.position;
+	parser.resume.searched = push_parser->resume.searched;
+	parser.resume.byte = push_parser->resume.byte;
+
+	push_parser->result = xml_reader_run(&push_parser->reader, &parser);
+	if (XML_READER_ERROR == push_parser->result) {
+		push_parser->reader.error.offset += push_parser->consumed;
+		xml_reader_error_path(&push_parser->reader);
 	}
 
-	return node->children[child];
-}
+	/* Keep the incomplete token, relative to the compacted input
+	 */
+	size_t consumed = parser.position;
+	if (XML_PARSER_DONE == push_parser->reader.state) {
+		consumed = push_parser->input.length;
+	}
 
+	if (consumed) {
+		push_parser->consumed += consumed;
+		push_parser->input.length -= consumed;
+		memmove(push_parser->input.buffer, &push_parser->input.buffer[consumed], push_parser->input.length);
+	}
 
+	push_parser->resume.byte = 0;
+	if ((parser.resume.byte) && (parser.resume.position >= consumed)) {
+		push_parser->resume.position = parser.resume.position - consumed;
+		push_parser->resume.searched = parser.resume.searched - consumed;
+		push_parser->resume.byte = parser.resume.byte;
+	}
 
-/**
- * [PUBLIC API]
- */
-size_t xml_node_attributes(struct xml_node* node) {
-	return get_zero_terminated_array_attributes(node->attributes);
+	return push_parser->result;
 }
 
 
@@ -985,12 +6012,8 @@ size_t xml_node_attributes(struct xml_node* node) {
 /**
  * [PUBLIC API]
  */
-struct xml_string* xml_node_attribute_name(struct xml_node* node, size_t attribute) {
-	if(attribute >= xml_node_attributes(node)) {
-		return 0;
-	}
-
-	return node->attributes[attribute]->name;
+struct xml_push_parser* xml_push_parser_create(struct xml_reader_callbacks const* callbacks, void* context) {
+	return xml_push_parser_create_ex(callbacks, context, 0);
 }
 
 
@@ -998,12 +6021,23 @@ struct xml_string* xml_node_attribute_name(struct xml_node* node, size_t attribu
 /**
  * [PUBLIC API]
  */
-struct xml_string* xml_node_attribute_content(struct xml_node* node, size_t attribute) {
-	if(attribute >= xml_node_attributes(node)) {
+struct xml_push_parser* xml_push_parser_create_ex(struct xml_reader_callbacks const* callbacks, void* context, struct xml_options const* options) {
+	struct xml_allocator allocator = xml_allocator_select(options);
+
+	struct xml_push_parser* push_parser = xml_alloc(&allocator, sizeof(struct xml_push_parser));
+	if (!push_parser) {
 		return 0;
 	}
+	memset(push_parser, 0, sizeof(struct xml_push_parser));
 
-	return node->attributes[attribute]->content;
+	push_parser->reader.callbacks = *callbacks;
+	push_parser->reader.context = context;
+	push_parser->reader.allocator = allocator;
+	xml_reader_reset(&push_parser->reader);
+	push_parser->result = XML_READER_SUCCESS;
+	push_parser->consumed = 0;
+
+	return push_parser;
 }
 
 
@@ -1011,78 +6045,32 @@ struct xml_string* xml_node_attribute_content(struct xml_node* node, size_t attr
 /**
  * [PUBLIC API]
  */
-struct xml_node* xml_easy_child(struct xml_node* node, uint8_t const* child_name, ...) {
+enum xml_reader_result xml_push_parser_feed(struct xml_push_parser* push_parser, uint8_t const* bytes, size_t length) {
 
-	/* Find children, one by one
+	/* Errors are final, data following the document will be ignored
 	 */
-	struct xml_node* current = node;
-
-	va_list arguments;
-	va_start(arguments, child_name);
-
+	if ((XML_READER_SUCCESS != push_parser->result) || (XML_PARSER_DONE == push_parser->reader.state)) {
+		return push_parser->result;
+	}
 
-	/* Descent to current.child
+	/* First chunk of a document, forget the previous document's error
 	 */
-	while (child_name) {
-
-		/* Convert child_name to xml_string for easy comparison
-		 */
-		struct xml_string cn = {
-			.buffer = child_name,
-			.length = strlen(child_name)
-		};
-
-		/* Interate through all children
-		 */
-		struct xml_node* next = 0;
-
-		size_t i = 0; for (; i < xml_node_children(current); ++i) {
-			struct xml_node* child = xml_node_child(current, i);
-
-			if (xml_string_equals(xml_node_name(child), &cn)) {
-				if (!next) {
-					next = child;
-
-				/* Two children with the same name
-				 */
-				} else {
-					va_end(arguments);
-					return 0;
-				}
-			}
-		}
-
-		/* No child with that name found
-		 */
-		if (!next) {
-			va_end(arguments);
-			return 0;
-		}
-		current = next;		
-		
-		/* Find name of next child
-		 */
-		child_name = va_arg(arguments, uint8_t const*);
+	if (!push_parser->consumed && !push_parser->input.length) {
+		push_parser->reader.error.code = XML_ERROR_NONE;
 	}
-	va_end(arguments);
 
-
-	/* Return current element
+	/* Append chunk to the not yet consumed input
 	 */
-	return current;
-}
-
-
-
-/**
- * [PUBLIC API]
- */
-uint8_t* xml_easy_name(struct xml_node* node) {
-	if (!node) {
-		return 0;
+	if (!xml_array_reserve(&push_parser->reader.allocator, (void**)&push_parser->input.buffer, &push_parser->input.capacity, push_parser->input.length, length, sizeof(uint8_t))) {
+		xml_error_set(&push_parser->reader.error, XML_ERROR_OUT_OF_MEMORY, push_parser->consumed + push_parser->input.length, "xml_push_parser_feed::out of memory");
+		return push_parser->result = XML_READER_ERROR;
+	}
+	if (length) {
+		memcpy(&push_parser->input.buffer[push_parser->input.length], bytes, length);
+		push_parser->input.length += length;
 	}
 
-	return xml_string_clone(xml_node_name(node));
+	return xml_push_parser_run(push_parser, true);
 }
 
 
@@ -1090,12 +6078,24 @@ uint8_t* xml_easy_name(struct xml_node* node) {
 /**
  * [PUBLIC API]
  */
-uint8_t* xml_easy_content(struct xml_node* node) {
-	if (!node) {
-		return 0;
+enum xml_reader_result xml_push_parser_finish(struct xml_push_parser* push_parser) {
+	enum xml_reader_result result = push_parser->result;
+
+	/* Remaining input has to complete the document
+	 */
+	if ((XML_READER_SUCCESS == result) && (XML_PARSER_DONE != push_parser->reader.state)) {
+		result = xml_push_parser_run(push_parser, false);
 	}
 
-	return xml_string_clone(xml_node_content(node));
+	/* Prepare for the next document
+	 */
+	xml_reader_reset(&push_parser->reader);
+	push_parser->result = XML_READER_SUCCESS;
+	push_parser->consumed = 0;
+	push_parser->input.length = 0;
+	push_parser->resume.byte = 0;
+
+	return result;
 }
 
 
@@ -1103,11 +6103,8 @@ uint8_t* xml_easy_content(struct xml_node* node) {
 /**
  * [PUBLIC API]
  */
-size_t xml_string_length(struct xml_string* string) {
-	if (!string) {
-		return 0;
-	}
-	return string->length;
+struct xml_error const* xml_push_parser_error(struct xml_push_parser* push_parser) {
+	return &push_parser->reader.error;
 }
 
 
@@ -1115,15 +6112,11 @@ size_t xml_string_length(struct xml_string* string) {
 /**
  * [PUBLIC API]
  */
-void xml_string_copy(struct xml_string* string, uint8_t* buffer, size_t length) {
-	if (!string) {
-		return;
-	}
-
-	#define min(X,Y) ((X) < (Y) ? (X) : (Y))
-	length = min(length, string->length);
-	#undef min
+void xml_push_parser_free(struct xml_push_parser* push_parser) {
+	struct xml_allocator allocator = push_parser->reader.allocator;
 
-	memcpy(buffer, string->buffer, length);
+	xml_free(&allocator, push_parser->input.buffer);
+	xml_free(&allocator, push_parser->reader.names.buffer);
+	xml_free(&allocator, push_parser->reader.open.elements);
+	xml_free(&allocator, push_parser);
 }
-
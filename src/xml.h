@@ -40,8 +40,19 @@ extern "C" {
  * Opaque structure holding the parsed xml document
  */
 struct xml_document;
+struct xml_document_parser;
 struct xml_node;
 struct xml_attribute;
+struct xml_reader;
+struct xml_push_parser;
+struct xml_query;
+struct xml_query_iterator;
+struct xml_pool;
+
+/**
+ * Defined by <sys/uio.h> on POSIX systems, only used by xml_document_iovec
+ */
+struct iovec;
 
 /**
  * Internal character sequence representation
@@ -67,6 +78,143 @@ struct xml_document* xml_parse_document(uint8_t* buffer, size_t length);
 
 
 
+/**
+ * Reasons for a document to be rejected
+ */
+enum xml_error_code {
+	XML_ERROR_NONE = 0,
+	XML_ERROR_OUT_OF_MEMORY,
+	XML_ERROR_READ,
+	XML_ERROR_EMPTY_DOCUMENT,
+	XML_ERROR_SYNTAX,
+	XML_ERROR_TAG_MISMATCH,
+	XML_ERROR_UNEXPECTED_END,
+	XML_ERROR_MAXIMUM_DEPTH,
+};
+
+
+
+/**
+ * Maximum length of xml_error.path including the terminating 0
+ */
+#define XML_ERROR_MAXIMUM_PATH 256
+
+
+
+/**
+ * Describes why parsing failed. Only the first error detected is reported
+ *
+ * @field code Kind of error, XML_ERROR_NONE iff parsing succeeded
+ * @field offset Byte offset into the parsed buffer at which the error has been
+ *     detected
+ * @field message Static, human readable description of the error
+ * @field path Names of the elements open at `offset`, e.g. `/Root/Item`. Paths
+ *     too long to fit are truncated
+ */
+struct xml_error {
+	enum xml_error_code code;
+	size_t offset;
+	char const* message;
+	char path[XML_ERROR_MAXIMUM_PATH];
+};
+
+
+
+/**
+ * Determines line and column of an error by scanning the buffer up to the
+ * error's offset. Nothing is computed while parsing, so the position costs
+ * only if asked for
+ *
+ * @param buffer Buffer which has been parsed
+ * @param line Receives the line of the error, counting from 1
+ * @param column Receives the column of the error in bytes, counting from 1
+ */
+void xml_error_position(struct xml_error const* error, uint8_t const* buffer, size_t* line, size_t* column);
+
+
+
+/**
+ * Memory allocator used for everything a document holds, including the
+ * document itself and memory only needed while parsing, as well as for
+ * readers, push parsers and queries created with it. Strings returned by
+ * xml_easy_name and xml_easy_content are the only memory still allocated by
+ * `malloc`, since the caller releases them with `free`. Functions are never
+ * called with a NULL `memory` or a `size` of zero and have to be thread safe
+ * if documents are parsed by several threads
+ *
+ * @field alloc Returns `size` bytes of uninitialized memory or NULL if none is
+ *     available
+ * @field realloc Resizes `memory` to `size` bytes like the `realloc` system
+ *     call, returns NULL and leaves `memory` untouched on failure
+ * @field free Releases `memory` returned by `alloc` or `realloc`
+ * @field context Passed to each function as is
+ */
+struct xml_allocator {
+	void* (*alloc)(void* context, size_t size);
+	void* (*realloc)(void* context, void* memory, size_t size);
+	void (*free)(void* context, void* memory);
+	void* context;
+};
+
+
+
+/**
+ * Parser settings accepted by xml_parse_document_ex. Zero initialize the
+ * structure and only set the fields you care about
+ *
+ * @field max_depth Maximum number of nested elements, deeper documents fail
+ *     to parse. 0 means unlimited
+ * @field lazy Iff true, only the extent of each element is determined while
+ *     parsing. Attributes, content and children of a node are parsed when they
+ *     are first accessed, so untouched subtrees cost no allocations. Skipped
+ *     elements are checked like any other, lazy and eager parsing accept the
+ *     same documents
+ *
+ * @field threads Maximum number of threads parsing the document. Large
+ *     documents are split between the root's children, the result is the same
+ *     as if the document was parsed by a single thread. 0 and 1 disable
+ *     parallel parsing, which is also not available for lazy documents
+ * @field pool Threads to parse on, see xml_pool_create. NULL means threads
+ *     are started for each document or batch and joined afterwards
+ *
+ * @field decode Iff true, entity and character references in text content
+ *     and attribute values are decoded while parsing. Decoding happens in
+ *     place, so `buffer` will be modified and strings without references
+ *     are still referenced directly. Otherwise strings are returned raw and
+ *     may be decoded using xml_string_decode
+ *
+ * @field allocator Memory allocator of the document, the structure is copied.
+ *     NULL means the `malloc` family of system calls
+ * @field error Receives the reason if parsing fails and is reset otherwise,
+ *     may be NULL. The library never prints errors
+ *
+ * @warning A lazy node which cannot be parsed on access for lack of memory
+ *     appears empty, see xml_document_error. Accessing lazy nodes modifies
+ *     the document, thus must not happen concurrently
+ */
+struct xml_options {
+	size_t max_depth;
+	bool lazy;
+	size_t threads;
+	struct xml_pool* pool;
+	bool decode;
+	struct xml_allocator const* allocator;
+	struct xml_error* error;
+};
+
+
+
+/**
+ * Like xml_parse_document but with explicit parser settings
+ *
+ * @param options Parser settings, may be NULL to use the defaults
+ *
+ * @return The parsed xml fragment iff parsing was successful, 0 otherwise
+ */
+struct xml_document* xml_parse_document_ex(uint8_t* buffer, size_t length, struct xml_options const* options);
+
+
+
 /**
  * Tries to read an XML document from disk
  *
@@ -81,17 +229,207 @@ struct xml_document* xml_open_document(FILE* source);
 
 
 
+/**
+ * Like xml_open_document but with explicit parser settings, the buffer holding
+ * the file is allocated by the allocator of `options`
+ *
+ * @param options Parser settings, may be NULL to use the defaults
+ *
+ * @return The parsed xml fragment iff parsing was successful, 0 otherwise
+ */
+struct xml_document* xml_open_document_ex(FILE* source, struct xml_options const* options);
+
+
+
+/**
+ * Tries to read an XML document from disk by mapping the file into memory. The
+ * mapping is parsed in place without copying the file
+ *
+ * @param path File that will be read into an xml document
+ *
+ * @warning You have to call xml_document_free after you finished using the
+ *     document, the mapping will be released regardless of `free_buffer`
+ *
+ * @return The parsed xml fragment iff parsing was successful, 0 otherwise
+ */
+struct xml_document* xml_open_path(char const* path);
+
+
+
+/**
+ * Like xml_open_path but with explicit parser settings. The mapping is
+ * private, decoding references modifies the document's copy of the file only
+ *
+ * @param options Parser settings, may be NULL to use the defaults. Errors
+ *     opening or mapping the file are reported as XML_ERROR_READ
+ *
+ * @return The parsed xml fragment iff parsing was successful, 0 otherwise
+ */
+struct xml_document* xml_open_path_ex(char const* path, struct xml_options const* options);
+
+
+
 /**
  * Frees all resources associated with the document. All xml_node and xml_string
  * references obtained through the document will be invalidated
  *
  * @param document xml_document to free
  * @param free_buffer iff true the internal buffer supplied via xml_parse_buffer
- *     will be freed with the `free` system call
+ *     will be freed by the document's allocator, which is the `free` system
+ *     call unless specified otherwise. Ignored for documents opened by
+ *     xml_open_path or xml_open_path_ex
  */
 void xml_document_free(struct xml_document* document, bool free_buffer);
 
 
+/**
+ * Creates a parser context which can be reused for any number of documents.
+ * Memory for nodes, strings and names as well as the parser's scratch space is
+ * kept between documents, so once it has grown large enough for the documents
+ * at hand, parsing does not allocate anymore. Unless a pool is given, the
+ * context starts a pool of its own if `threads` is larger than 1
+ *
+ * @param options Parser settings used for every document, may be NULL to use
+ *     the defaults
+ *
+ * @warning You have to call xml_document_parser_free after you finished using
+ *     the context
+ *
+ * @return The parser context or 0 if the system is out of memory
+ */
+struct xml_document_parser* xml_document_parser_create(struct xml_options const* options);
+
+
+
+/**
+ * Parses a document like xml_parse_document_ex, reusing the context's memory
+ *
+ * @param buffer Chunk to parse
+ * @param length Size of the buffer
+ *
+ * @warning The document is owned by the context and stays valid until the next
+ *     document is parsed or the context is reset or freed. Never pass it to
+ *     xml_document_free
+ * @warning `buffer` will be referenced by the document, you may not free it
+ *     until the document becomes invalid
+ *
+ * @return The parsed xml fragment iff parsing was successful, 0 otherwise
+ */
+struct xml_document* xml_document_parser_parse(struct xml_document_parser* context, uint8_t* buffer, size_t length);
+
+
+
+/**
+ * Invalidates the document last parsed by the context, without releasing any
+ * memory
+ */
+void xml_document_parser_reset(struct xml_document_parser* context);
+
+
+
+/**
+ * Frees the context and all memory it holds, invalidating the document last
+ * parsed by it
+ */
+void xml_document_parser_free(struct xml_document_parser* context);
+
+
+
+/**
+ * Starts `options->threads` - 1 threads which wait for documents to parse.
+ * Set as xml_options.pool, parallel and batch parsing run on them together
+ * with the calling thread instead of starting threads for every call. Work is
+ * still split into `threads` shares as without a pool. Calls sharing a pool
+ * take turns
+ *
+ * @param options Number of threads and allocator of the pool, may be NULL to
+ *     only use the calling thread
+ *
+ * @warning You have to call xml_pool_free after all calls using the pool have
+ *     returned
+ *
+ * @return The pool or 0 if the system is out of memory. Should not all
+ *     threads start, the calling thread takes on their work
+ */
+struct xml_pool* xml_pool_create(struct xml_options const* options);
+
+
+
+/**
+ * Stops and joins the pool's threads and frees the pool
+ */
+void xml_pool_free(struct xml_pool* pool);
+
+
+
+/**
+ * One document of a batch
+ */
+struct xml_batch_input {
+	uint8_t* buffer;
+	size_t length;
+};
+
+
+
+/**
+ * Result of parsing one document of a batch
+ *
+ * @field document The parsed document iff parsing was successful, 0 otherwise
+ * @field error Why parsing failed
+ * @field seconds Time spent parsing the document
+ *
+ * @warning You have to call xml_document_free for each document after you
+ *     finished using it
+ */
+struct xml_batch_output {
+	struct xml_document* document;
+	struct xml_error error;
+	double seconds;
+};
+
+
+
+/**
+ * Parses many independent documents using up to `options->threads` threads,
+ * those of `options->pool` if given. Each thread starts with an equal share of
+ * the batch and steals from the others once its share is done, reusing its
+ * parser's scratch space for all documents it parses. Each document is parsed
+ * by a single thread
+ *
+ * @param inputs Documents to parse, see xml_parse_document_ex
+ * @param length Number of documents
+ * @param outputs Receives the result of `inputs[i]` at `outputs[i]`
+ * @param options Parser settings for all documents, may be NULL to use the
+ *     defaults. `error` is ignored in favor of the errors of `outputs`
+ *
+ * @return Number of documents parsed successfully
+ */
+size_t xml_parse_batch(struct xml_batch_input const* inputs, size_t length, struct xml_batch_output* outputs, struct xml_options const* options);
+
+
+
+/**
+ * @return Number of bytes used by the document, including lazily built child
+ *     indices but excluding the buffer
+ */
+size_t xml_document_memory(struct xml_document* document);
+
+
+
+/**
+ * Lazy nodes are parsed when first accessed, after the document has been
+ * returned. Their markup has been checked up front, but parsing them may still
+ * run out of memory, which leaves the node without attributes, content and
+ * children
+ *
+ * @return First error encountered while parsing lazy nodes, its code is
+ *     XML_ERROR_NONE if there was none
+ */
+struct xml_error const* xml_document_error(struct xml_document* document);
+
+
+
 /**
  * @return xml_node representing the document root
  */
@@ -99,6 +437,13 @@ struct xml_node* xml_document_root(struct xml_document* document);
 
 
 
+/**
+ * @return xml_document the node belongs to
+ */
+struct xml_document* xml_node_document(struct xml_node* node);
+
+
+
 /**
  * @return The xml_node's tag name
  */
@@ -148,6 +493,56 @@ struct xml_string* xml_node_attribute_content(struct xml_node* node, size_t attr
 
 
 
+/**
+ * Element and attribute names are interned while parsing, each distinct name
+ * of a document is identified by a symbol greater than 0. Comparing symbols is
+ * considerably cheaper than comparing names
+ *
+ * @return Symbol of the name or 0 if no element or attribute of the document
+ *     has this name. Lazy documents only know the names of accessed nodes and
+ *     their children
+ */
+uint32_t xml_document_symbol(struct xml_document* document, uint8_t const* name, size_t length);
+
+
+
+/**
+ * @return Symbol of the xml_node's tag name
+ */
+uint32_t xml_node_symbol(struct xml_node* node);
+
+
+
+/**
+ * @return The only child whose tag name has the given symbol or 0 if there is
+ *     no or more than one such child
+ */
+struct xml_node* xml_node_child_by_symbol(struct xml_node* node, uint32_t symbol);
+
+
+
+/**
+ * Lookups by symbol on nodes with many children build an index from child
+ * name to child positions on first use, making further lookups O(1). The index
+ * is allocated from the document
+ *
+ * @warning Lookups by name or symbol may modify the document, they must not run
+ *     concurrently on the same document
+ *
+ * @return Number of children whose tag name has the given symbol
+ */
+size_t xml_node_named_children(struct xml_node* node, uint32_t symbol);
+
+
+
+/**
+ * @return The n-th child whose tag name has the given symbol or 0 if out of
+ *     range
+ */
+struct xml_node* xml_node_named_child(struct xml_node* node, uint32_t symbol, size_t child);
+
+
+
 /**
  * @return The node described by the path or 0 if child cannot be found
  * @warning Each element on the way must be unique
@@ -158,16 +553,20 @@ struct xml_node* xml_easy_child(struct xml_node* node, uint8_t const* child, ...
 
 
 /**
- * @return 0-terminated copy of node name
- * @warning User must free the result
+ * @return 0-terminated copy of node name or 0 if `node` is 0 or no memory
+ *     is available
+ * @warning The copy is allocated by `malloc` regardless of the document's
+ *     allocator, user must release it with `free`
  */
 uint8_t* xml_easy_name(struct xml_node* node);
 
 
 
 /**
- * @return 0-terminated copy of node content
- * @warning User must free the result
+ * @return 0-terminated copy of node content or 0 if `node` is 0 or no memory
+ *     is available
+ * @warning The copy is allocated by `malloc` regardless of the document's
+ *     allocator, user must release it with `free`
  */
 uint8_t* xml_easy_content(struct xml_node* node);
 
@@ -180,6 +579,16 @@ size_t xml_string_length(struct xml_string* string);
 
 
 
+/**
+ * @return The string's bytes without copying them, 0 for an empty string
+ *
+ * @warning String will not be 0-terminated. The bytes are only valid as long
+ *     as the document
+ */
+uint8_t const* xml_string_buffer(struct xml_string* string);
+
+
+
 /**
  * Copies the string into the supplied buffer
  *
@@ -188,6 +597,350 @@ size_t xml_string_length(struct xml_string* string);
  */
 void xml_string_copy(struct xml_string* string, uint8_t* buffer, size_t length);
 
+
+
+/**
+ * Copies the string into the supplied buffer while decoding the predefined
+ * entities `&amp;`, `&lt;`, `&gt;`, `&quot;` and `&apos;` as well as
+ * character references like `&#169;` and `&#x20AC;` to UTF-8. Anything else
+ * starting with `&` is copied unchanged
+ *
+ * @return Length of the decoded string, which is never longer than the
+ *     string itself
+ *
+ * @warning String will not be 0-terminated
+ * @warning Will write at most length bytes, even if the decoded string is
+ *     longer
+ */
+size_t xml_string_decode(struct xml_string* string, uint8_t* buffer, size_t length);
+
+
+
+/**
+ * Replaces the xml_node's text content by a copy of `content`, allocated from
+ * the document. Like all strings of the document, it is expected to be markup
+ * unless the document has been parsed with `decode`, in which case it is
+ * escaped when written
+ *
+ * @warning Invalidates the string previously returned by xml_node_content
+ *
+ * @return false iff the node has children or the system is out of memory
+ */
+bool xml_node_set_content(struct xml_node* node, uint8_t const* content, size_t length);
+
+
+
+/**
+ * Replaces the n-th attribute content, see xml_node_set_content
+ *
+ * @return false iff the attribute is out of range or the system is out of
+ *     memory
+ */
+bool xml_node_set_attribute_content(struct xml_node* node, size_t attribute, uint8_t const* content, size_t length);
+
+
+
+/**
+ * Writes the document as XML. Markup of unmodified nodes is written exactly as
+ * it was parsed and referenced instead of copied, so writing a mostly
+ * unmodified document costs little more than writing its buffer. Modified
+ * nodes and their ancestors are written anew, keeping the whitespace between
+ * their children
+ *
+ * @param destination Stream the document will be written to, which will not
+ *     be flushed
+ *
+ * @return true iff the whole document has been written
+ */
+bool xml_document_write(struct xml_document* document, FILE* destination);
+
+
+
+/**
+ * Like xml_document_write but writes to a file descriptor using writev
+ *
+ * @return true iff the whole document has been written, always false on
+ *     systems without writev
+ */
+bool xml_document_write_fd(struct xml_document* document, int descriptor);
+
+
+
+/**
+ * Like xml_document_write but writes into a buffer
+ *
+ * @warning Will write at most length bytes, even if the document is longer
+ *
+ * @return Length of the whole document, which may exceed `length`, or 0 if
+ *     the system is out of memory
+ */
+size_t xml_document_write_buffer(struct xml_document* document, uint8_t* buffer, size_t length);
+
+
+
+/**
+ * Describes the document as written by xml_document_write by chunks ready
+ * for writev. Chunks reference the document's buffer and strings, which must
+ * be neither modified nor freed while the chunks are in use
+ *
+ * @warning Will store at most capacity chunks, even if there are more
+ *
+ * @return Number of chunks the whole document consists of, which may exceed
+ *     `capacity`, or 0 if the system is out of memory or has no writev
+ */
+size_t xml_document_iovec(struct xml_document* document, struct iovec* iovecs, size_t capacity);
+
+
+
+/**
+ * Compiles a query selecting elements by their path, a subset of XPath
+ *
+ * ---( Example )---
+ * /feed/item[@type='x']/price
+ * //item[2]
+ * *[@id]
+ * item/price
+ * ---
+ *
+ * Steps are separated by `/` to select children or `//` to select all
+ * descendants. Each step tests the element name, `*` matches any name, and
+ * may be followed by predicates: `[@name]` requires an attribute,
+ * `[@name='value']` its content to equal the value and `[n]` selects the n-th
+ * element among its siblings passing the preceding tests. Queries starting
+ * with `/` select the node they are run against by their first step,
+ * otherwise they start with its children
+ *
+ * @warning You have to call xml_query_free after you finished using the query
+ *
+ * @return The compiled query or 0 if the expression is malformed or the
+ *     system is out of memory
+ */
+struct xml_query* xml_query_compile(char const* expression);
+
+
+
+/**
+ * Like xml_query_compile but allocating the query by the allocator of
+ * `options`, all other settings are ignored. Iterators are allocated by the
+ * allocator of the document they are run against
+ *
+ * @param options Settings, may be NULL to use the defaults
+ */
+struct xml_query* xml_query_compile_ex(char const* expression, struct xml_options const* options);
+
+
+
+/**
+ * Frees all resources associated with the query
+ */
+void xml_query_free(struct xml_query* query);
+
+
+
+/**
+ * Runs the query against a node. Matching elements are found one at a time
+ * while iterating, so the query stops as soon as the caller does. Only the
+ * elements on paths which may still match are visited, in lazy documents
+ * all others are never parsed
+ *
+ * @warning The query must not be freed before the iterator
+ * @warning You have to call xml_query_iterator_free after you finished using
+ *     the iterator
+ *
+ * @return New iterator or 0 if the system is out of memory
+ */
+struct xml_query_iterator* xml_query_iterate(struct xml_query const* query, struct xml_node* node);
+
+
+
+/**
+ * @return The next matching element in document order or 0 if there is none
+ *     or the system is out of memory
+ */
+struct xml_node* xml_query_next(struct xml_query_iterator* iterator);
+
+
+
+/**
+ * Frees all resources associated with the iterator
+ */
+void xml_query_iterator_free(struct xml_query_iterator* iterator);
+
+
+
+/**
+ * Callbacks invoked by an xml_reader while it walks through a document. Each
+ * callback may be 0 if the event is of no interest. Returning false from a
+ * callback aborts parsing
+ *
+ * For every element `start_element` is invoked first, followed by one
+ * `attribute` call per attribute. Afterwards either `text` is invoked once or
+ * the children's events follow. `end_element` concludes the element
+ *
+ * @warning All strings reference the parsed buffer and are only valid while
+ *     the buffer is
+ */
+struct xml_reader_callbacks {
+	bool (*start_element)(void* context, struct xml_string* name);
+	bool (*attribute)(void* context, struct xml_string* name, struct xml_string* content);
+	bool (*text)(void* context, struct xml_string* content);
+	bool (*end_element)(void* context, struct xml_string* name);
+};
+
+/**
+ * Outcome of xml_reader_parse
+ */
+enum xml_reader_result {
+	XML_READER_SUCCESS,
+	XML_READER_ABORTED,
+	XML_READER_ERROR,
+};
+
+
+
+/**
+ * Creates a streaming reader which reports the document's structure through
+ * callbacks instead of building a tree. Memory usage is bounded by the
+ * document's nesting depth
+ *
+ * @param callbacks Events to report, will be copied
+ * @param context Passed to every callback
+ *
+ * @warning You have to call xml_reader_free after you finished using the
+ *     reader
+ *
+ * @return New reader or 0 if the system is out of memory
+ */
+struct xml_reader* xml_reader_create(struct xml_reader_callbacks const* callbacks, void* context);
+
+
+
+/**
+ * Like xml_reader_create but allocating the reader and the names of open
+ * elements by the allocator of `options`, all other settings are ignored
+ *
+ * @param options Settings, may be NULL to use the defaults
+ */
+struct xml_reader* xml_reader_create_ex(struct xml_reader_callbacks const* callbacks, void* context, struct xml_options const* options);
+
+
+
+/**
+ * Walks through the XML fragment in buffer, invoking the reader's callbacks.
+ * The reader may be used for any number of documents
+ *
+ * @param buffer Chunk to parse, e.g. a file mapped into memory
+ * @param length Size of the buffer
+ *
+ * @return XML_READER_SUCCESS iff the whole fragment has been read,
+ *     XML_READER_ABORTED iff a callback returned false and XML_READER_ERROR
+ *     iff the fragment is malformed
+ */
+enum xml_reader_result xml_reader_parse(struct xml_reader* reader, uint8_t* buffer, size_t length);
+
+
+
+/**
+ * @return Why the last call of xml_reader_parse returned XML_READER_ERROR,
+ *     valid until the reader is used again
+ */
+struct xml_error const* xml_reader_error(struct xml_reader* reader);
+
+
+
+/**
+ * Frees all resources associated with the reader
+ */
+void xml_reader_free(struct xml_reader* reader);
+
+
+
+/**
+ * Checks whether the XML fragment in buffer is well-formed as far as
+ * xml_parse_document is concerned, without building a tree. Only the names of
+ * open elements are kept, so memory is bounded by the nesting depth
+ *
+ * @param buffer Chunk to check, will not be modified
+ * @param length Size of the buffer
+ * @param error Receives the reason if the fragment is malformed and is reset
+ *     otherwise, may be NULL
+ *
+ * @return true iff xml_parse_document would accept the fragment
+ */
+bool xml_validate(uint8_t const* buffer, size_t length, struct xml_error* error);
+
+
+
+/**
+ * Creates a push parser, which reports the same events as an xml_reader but
+ * accepts the document in chunks of arbitrary size. Tokens split across chunks
+ * are kept until they are complete, so processing starts before the last byte
+ * arrived
+ *
+ * @param callbacks Events to report, will be copied
+ * @param context Passed to every callback
+ *
+ * @warning You have to call xml_push_parser_free after you finished using the
+ *     push parser
+ *
+ * @return New push parser or 0 if the system is out of memory
+ */
+struct xml_push_parser* xml_push_parser_create(struct xml_reader_callbacks const* callbacks, void* context);
+
+
+
+/**
+ * Like xml_push_parser_create but allocating the push parser and its input by
+ * the allocator of `options`, all other settings are ignored
+ *
+ * @param options Settings, may be NULL to use the defaults
+ */
+struct xml_push_parser* xml_push_parser_create_ex(struct xml_reader_callbacks const* callbacks, void* context, struct xml_options const* options);
+
+
+
+/**
+ * Passes the next chunk of the document to the push parser. Events for all
+ * complete tokens are reported before returning
+ *
+ * @param bytes Chunk of the document, will be copied as far as necessary
+ * @param length Size of the chunk
+ *
+ * @return XML_READER_SUCCESS iff the document is well-formed so far,
+ *     XML_READER_ABORTED iff a callback returned false and XML_READER_ERROR
+ *     iff the document is malformed. Once aborted or failed, all further
+ *     chunks will be ignored
+ */
+enum xml_reader_result xml_push_parser_feed(struct xml_push_parser* parser, uint8_t const* bytes, size_t length);
+
+
+
+/**
+ * Signals the end of the document. Afterwards the push parser is ready to
+ * accept the next document
+ *
+ * @return XML_READER_SUCCESS iff a complete document has been read,
+ *     otherwise the first failure
+ */
+enum xml_reader_result xml_push_parser_finish(struct xml_push_parser* parser);
+
+
+
+/**
+ * @return Why the current document has been rejected. Offsets count from the
+ *     first byte of the document, since the push parser does not keep the
+ *     whole document, xml_error_position is not available. Valid until the
+ *     first chunk of the next document is fed
+ */
+struct xml_error const* xml_push_parser_error(struct xml_push_parser* parser);
+
+
+
+/**
+ * Frees all resources associated with the push parser
+ */
+void xml_push_parser_free(struct xml_push_parser* parser);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,348 @@
+/**
+ * Copyright (c) 2012 ooxi/xml.c
+ *     https://github.com/ooxi/xml.c
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software in a
+ *     product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ * 
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *
+ *  3. This notice may not be removed or altered from any source distribution.
+ */
+#ifndef HEADER_XML_HPP
+#define HEADER_XML_HPP
+
+
+/**
+ * Includes
+ */
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include "xml.h"
+
+
+/**
+ * Header-only C++17 interface. Nodes, attributes and strings are views into
+ * the document, nothing is copied or allocated on top of the C library and no
+ * function throws
+ */
+namespace xml {
+
+
+
+/**
+ * @return Bytes of `string` without copying them, empty for a null string
+ */
+inline std::string_view view(struct xml_string* string) noexcept {
+	std::uint8_t const* buffer = xml_string_buffer(string);
+
+	if (!buffer) {
+		return std::string_view();
+	}
+	return std::string_view(reinterpret_cast<char const*>(buffer), xml_string_length(string));
+}
+
+
+
+/**
+ * Random access over the elements `0 ... size()` of a node, each made by
+ * `Element(node, index)`. Used to iterate children and attributes
+ */
+template <typename Element>
+class node_range {
+public:
+	class iterator {
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = Element;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = Element;
+
+		iterator() noexcept = default;
+		iterator(struct xml_node* node, std::size_t index) noexcept : _node(node), _index(index) {}
+
+		Element operator*() const noexcept { return Element(_node, _index); }
+		Element operator[](difference_type offset) const noexcept { return Element(_node, _index + offset); }
+
+		iterator& operator++() noexcept { ++_index; return *this; }
+		iterator operator++(int) noexcept { iterator previous = *this; ++_index; return previous; }
+		iterator& operator--() noexcept { --_index; return *this; }
+		iterator operator--(int) noexcept { iterator previous = *this; --_index; return previous; }
+
+		iterator& operator+=(difference_type offset) noexcept { _index += offset; return *this; }
+		iterator& operator-=(difference_type offset) noexcept { _index -= offset; return *this; }
+		iterator operator+(difference_type offset) const noexcept { return iterator(_node, _index + offset); }
+		iterator operator-(difference_type offset) const noexcept { return iterator(_node, _index - offset); }
+		difference_type operator-(iterator const& other) const noexcept { return static_cast<difference_type>(_index - other._index); }
+
+		bool operator==(iterator const& other) const noexcept { return _index == other._index; }
+		bool operator!=(iterator const& other) const noexcept { return _index != other._index; }
+		bool operator<(iterator const& other) const noexcept { return _index < other._index; }
+		bool operator>(iterator const& other) const noexcept { return _index > other._index; }
+		bool operator<=(iterator const& other) const noexcept { return _index <= other._index; }
+		bool operator>=(iterator const& other) const noexcept { return _index >= other._index; }
+
+	private:
+		struct xml_node* _node = nullptr;
+		std::size_t _index = 0;
+	};
+
+	node_range(struct xml_node* node, std::size_t size) noexcept : _node(node), _size(size) {}
+
+	iterator begin() const noexcept { return iterator(_node, 0); }
+	iterator end() const noexcept { return iterator(_node, _size); }
+
+	std::size_t size() const noexcept { return _size; }
+	bool empty() const noexcept { return !_size; }
+	Element operator[](std::size_t index) const noexcept { return Element(_node, index); }
+
+private:
+	struct xml_node* _node;
+	std::size_t _size;
+};
+
+
+
+/**
+ * Attribute of a node, identified by its position
+ */
+class attribute {
+public:
+	attribute(struct xml_node* node, std::size_t index) noexcept : _node(node), _index(index) {}
+
+	std::string_view name() const noexcept {
+		return view(xml_node_attribute_name(_node, _index));
+	}
+
+	std::string_view content() const noexcept {
+		return view(xml_node_attribute_content(_node, _index));
+	}
+
+private:
+	struct xml_node* _node;
+	std::size_t _index;
+};
+
+
+
+/**
+ * Non-owning handle of an xml_node, valid as long as its document. A default
+ * constructed node is null, as is a child which does not exist. Null nodes
+ * have no name, content, children or attributes
+ */
+class node {
+public:
+	node() noexcept = default;
+	explicit node(struct xml_node* handle) noexcept : _handle(handle) {}
+
+	/**
+	 * Child `index` of `parent`, used by node_range
+	 */
+	node(struct xml_node* parent, std::size_t index) noexcept : _handle(xml_node_child(parent, index)) {}
+
+	explicit operator bool() const noexcept { return _handle; }
+	struct xml_node* get() const noexcept { return _handle; }
+
+	bool operator==(node const& other) const noexcept { return _handle == other._handle; }
+	bool operator!=(node const& other) const noexcept { return _handle != other._handle; }
+
+	std::string_view name() const noexcept {
+		return _handle ? view(xml_node_name(_handle)) : std::string_view();
+	}
+
+	std::string_view content() const noexcept {
+		return _handle ? view(xml_node_content(_handle)) : std::string_view();
+	}
+
+	/**
+	 * @return Interned name, equal for nodes of the same document iff their
+	 *     names are equal
+	 */
+	std::uint32_t symbol() const noexcept {
+		return _handle ? xml_node_symbol(_handle) : 0;
+	}
+
+	node_range<node> children() const noexcept {
+		return node_range<node>(_handle, _handle ? xml_node_children(_handle) : 0);
+	}
+
+	node_range<xml::attribute> attributes() const noexcept {
+		return node_range<xml::attribute>(_handle, _handle ? xml_node_attributes(_handle) : 0);
+	}
+
+	/**
+	 * @return Child at `index` or a null node if there is none
+	 */
+	node child(std::size_t index) const noexcept {
+		return node(_handle ? xml_node_child(_handle, index) : nullptr);
+	}
+
+	/**
+	 * Looks up the name once in the document's symbol table, children are
+	 * then found by symbol, see xml_node_child_by_symbol
+	 *
+	 * @return The only child called `name` or a null node if there is no or
+	 *     more than one such child, like xml_easy_child
+	 */
+	node child(std::string_view name) const noexcept {
+
+		/* Loading the children interns their names in lazy documents
+		 */
+		if (!_handle || !xml_node_children(_handle)) {
+			return node();
+		}
+		return child_by_symbol(xml_document_symbol(xml_node_document(_handle), reinterpret_cast<std::uint8_t const*>(name.data()), name.size()));
+	}
+
+	/**
+	 * @return The only child whose name has `symbol` or a null node if there
+	 *     is no or more than one such child
+	 */
+	node child_by_symbol(std::uint32_t symbol) const noexcept {
+		return node(_handle ? xml_node_child_by_symbol(_handle, symbol) : nullptr);
+	}
+
+	/**
+	 * @return Number of children whose name has `symbol`
+	 */
+	std::size_t named_children(std::uint32_t symbol) const noexcept {
+		return _handle ? xml_node_named_children(_handle, symbol) : 0;
+	}
+
+	/**
+	 * @return Child `index` among those whose name has `symbol` or a null node
+	 *     if out of range
+	 */
+	node named_child(std::uint32_t symbol, std::size_t index) const noexcept {
+		return node(_handle ? xml_node_named_child(_handle, symbol, index) : nullptr);
+	}
+
+	/**
+	 * @return Content of the first attribute called `name`, empty if there is
+	 *     none
+	 */
+	std::string_view attribute_content(std::string_view name) const noexcept {
+		for (xml::attribute attribute : attributes()) {
+			if (attribute.name() == name) {
+				return attribute.content();
+			}
+		}
+		return std::string_view();
+	}
+
+private:
+	struct xml_node* _handle = nullptr;
+};
+
+
+
+/**
+ * Owns an xml_document and frees it on destruction. Documents can be moved
+ * but not copied, a default constructed or moved from document is empty
+ */
+class document {
+public:
+	document() noexcept = default;
+
+	/**
+	 * Takes ownership of `handle`, which is freed with `free_buffer`
+	 */
+	explicit document(struct xml_document* handle, bool free_buffer = false) noexcept : _handle(handle), _free_buffer(free_buffer) {}
+
+	document(document const&) = delete;
+	document& operator=(document const&) = delete;
+
+	document(document&& other) noexcept : _handle(std::exchange(other._handle, nullptr)), _free_buffer(other._free_buffer) {}
+
+	document& operator=(document&& other) noexcept {
+		if (this != &other) {
+			reset();
+			_handle = std::exchange(other._handle, nullptr);
+			_free_buffer = other._free_buffer;
+		}
+		return *this;
+	}
+
+	~document() {
+		reset();
+	}
+
+	/**
+	 * Parses `buffer` in place, see xml_parse_document_ex. The buffer is not
+	 * owned by the document and has to outlive it
+	 *
+	 * @return An empty document iff parsing failed
+	 */
+	static document parse(std::uint8_t* buffer, std::size_t length, struct xml_options const* options = nullptr) noexcept {
+		return document(xml_parse_document_ex(buffer, length, options));
+	}
+
+	/**
+	 * Maps the file at `path` into memory, see xml_open_path_ex
+	 *
+	 * @return An empty document iff the file could not be read or parsed
+	 */
+	static document open(char const* path, struct xml_options const* options = nullptr) noexcept {
+		return document(xml_open_path_ex(path, options));
+	}
+
+	explicit operator bool() const noexcept { return _handle; }
+	struct xml_document* get() const noexcept { return _handle; }
+
+	/**
+	 * Gives up ownership without freeing the document
+	 */
+	struct xml_document* release() noexcept {
+		return std::exchange(_handle, nullptr);
+	}
+
+	/**
+	 * Frees the document, invalidating all its nodes and strings
+	 */
+	void reset() noexcept {
+		if (_handle) {
+			xml_document_free(std::exchange(_handle, nullptr), _free_buffer);
+		}
+	}
+
+	node root() const noexcept {
+		return node(_handle ? xml_document_root(_handle) : nullptr);
+	}
+
+	/**
+	 * @return Symbol of `name` within the document, 0 if no element has this
+	 *     name
+	 */
+	std::uint32_t symbol(std::string_view name) const noexcept {
+		if (!_handle) {
+			return 0;
+		}
+		return xml_document_symbol(_handle, reinterpret_cast<std::uint8_t const*>(name.data()), name.size());
+	}
+
+private:
+	struct xml_document* _handle = nullptr;
+	bool _free_buffer = false;
+};
+
+
+
+} // namespace xml
+
+#endif
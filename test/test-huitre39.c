@@ -174,6 +174,17 @@ int main(int argc, char** argv) {
 	struct xml_node* does_not_exist = get_node_by_name(root, "does_not_exist");
 	assert_that(!does_not_exist, "Found node that should not exist");
 
+
+	/* A compiled query finds the same nodes without hand-written recursion
+	 */
+	struct xml_query* query = xml_query_compile("//us");
+	assert_that(query, "Could not compile query");
+
+	struct xml_query_iterator* iterator = xml_query_iterate(query, root);
+	assert_that(iterator && (us == xml_query_next(iterator)), "Query did not find element by tag name `us'");
+	xml_query_iterator_free(iterator);
+	xml_query_free(query);
+
 	
 
 	xml_document_free(document, false);
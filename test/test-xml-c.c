@@ -20,10 +20,16 @@
  *
  *  3. This notice may not be removed or altered from any source distribution.
  */
+#if !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <alloca.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/uio.h>
+#include <unistd.h>
 #include <xml.h>
 
 
@@ -62,7 +68,7 @@ static _Bool string_equals(struct xml_string* a, char const* b) {
 	}
 
 	size_t i = 0; for (; i < a_length; ++i) {
-		if (a_buffer[i] != b[i]) {
+		if (a_buffer[i] != (uint8_t)b[i]) {
 			fprintf(stderr, "string_equals: %s <> %s\n", a_buffer, b);
 			return false;
 		}
@@ -217,6 +223,134 @@ static void test_xml_parse_document_3() {
 
 
 
+/**
+ * Parses a document large enough to span multiple arena blocks
+ */
+static void test_xml_parse_document_4() {
+	size_t const children = 10000;
+	char const* const child = "<Child a=\"b\">Content</Child>";
+
+	uint8_t* source = calloc(strlen("<Parent></Parent>") + children * strlen(child) + 1, sizeof(uint8_t));
+	strcpy(source, "<Parent>");
+	size_t i = 0; for (; i < children; ++i) {
+		memcpy(source + strlen("<Parent>") + i * strlen(child), child, strlen(child));
+	}
+	strcat(source, "</Parent>");
+
+	struct xml_document* document = xml_parse_document(source, strlen(source));
+	assert_that(document, "Could not parse document");
+
+	struct xml_node* root = xml_document_root(document);
+	assert_that(children == xml_node_children(root), "root must have all children");
+
+	assert_that(!xml_node_child(root, children), "root must not have more children");
+
+	struct xml_node* last = xml_node_child(root, children - 1);
+	assert_that(string_equals(xml_node_name(last), "Child"), "last child name must be `Child'");
+	assert_that(string_equals(xml_node_content(last), "Content"), "last child content must be `Content'");
+	assert_that(string_equals(xml_node_attribute_content(last, 0), "b"), "last child attribute must be `b'");
+
+	xml_document_free(document, true);
+}
+
+
+
+/**
+ * Tests the xml_open_path functionality
+ */
+static void test_xml_parse_document_5() {
+	#define FILE_NAME "test.xml"
+	struct xml_document* document = xml_open_path(FILE_NAME);
+	assert_that(document, "Cannot open and parse " FILE_NAME);
+
+	struct xml_node* element = xml_easy_child(
+		xml_document_root(document), "Element", "With", 0
+	);
+	assert_that(element, "Cannot find Document/Element/With");
+	assert_that(string_equals(xml_node_content(element), "Child"), "Content of Document/Element/With must be `Child'");
+
+	xml_document_free(document, false);
+
+	assert_that(!xml_open_path("does-not-exist.xml"), "Must not open a missing file");
+	#undef FILE_NAME
+
+	/* Parser settings and errors apply to mapped files as well
+	 */
+	#define FILE_NAME "test-open-path.xml"
+	char const content[] = "<Root><A>x &amp; y</A><B></C></Root>";
+	FILE* file = fopen(FILE_NAME, "wb");
+	assert_that(file, "Cannot create " FILE_NAME);
+	fwrite(content, 1, strlen(content), file);
+	fclose(file);
+
+	struct xml_error error;
+	struct xml_options options = {0};
+	options.error = &error;
+	options.decode = true;
+
+	assert_that(!xml_open_path_ex("does-not-exist.xml", &options), "Must not open a missing file");
+	assert_that(XML_ERROR_READ == error.code, "missing file must be reported as read error");
+	assert_that(!xml_open_path_ex(FILE_NAME, &options), "Must not parse a malformed file");
+	assert_that((XML_ERROR_TAG_MISMATCH == error.code) && !strcmp("/Root/B", error.path), "malformed file must be reported");
+
+	file = fopen(FILE_NAME, "r+b");
+	assert_that(file, "Cannot open " FILE_NAME);
+	fseek(file, strstr(content, "C") - content, SEEK_SET);
+	fputc('B', file);
+	fclose(file);
+
+	document = xml_open_path_ex(FILE_NAME, &options);
+	assert_that(document && (XML_ERROR_NONE == error.code), "Cannot open and parse " FILE_NAME);
+	assert_that(string_equals(xml_node_content(xml_node_child(xml_document_root(document), 0)), "x & y"), "references must be decoded");
+	xml_document_free(document, false);
+
+	char unchanged[sizeof(content)] = {0};
+	file = fopen(FILE_NAME, "rb");
+	assert_that(file && fread(unchanged, 1, sizeof(unchanged), file), "Cannot read " FILE_NAME);
+	fclose(file);
+	assert_that(!strncmp(unchanged, "<Root><A>x &amp; y</A>", strlen("<Root><A>x &amp; y</A>")), "decoding must not modify the file");
+	remove(FILE_NAME);
+	#undef FILE_NAME
+}
+
+
+
+/**
+ * Parses a deeply nested document and rejects it once a depth limit is set
+ */
+static void test_xml_parse_document_6() {
+	size_t const depth = 100000;
+
+	uint8_t* source = calloc(depth * strlen("<a></a>") + 1, sizeof(uint8_t));
+	size_t i = 0; for (; i < depth; ++i) {
+		memcpy(source + i * strlen("<a>"), "<a>", strlen("<a>"));
+		memcpy(source + depth * strlen("<a>") + i * strlen("</a>"), "</a>", strlen("</a>"));
+	}
+
+	struct xml_document* document = xml_parse_document(source, strlen(source));
+	assert_that(document, "Could not parse deeply nested document");
+
+	struct xml_node* node = xml_document_root(document);
+	size_t levels = 0; for (; node; ++levels) {
+		node = xml_node_child(node, 0);
+	}
+	assert_that(depth == levels, "document must keep all levels");
+	xml_document_free(document, false);
+
+	struct xml_options options = {0};
+	options.max_depth = depth;
+	document = xml_parse_document_ex(source, strlen(source), &options);
+	assert_that(document, "document within depth limit must be parsed");
+	xml_document_free(document, false);
+
+	options.max_depth = depth - 1;
+	assert_that(!xml_parse_document_ex(source, strlen(source), &options), "document exceeding depth limit must be rejected");
+
+	free(source);
+}
+
+
+
 /**
  * Test parsing of attributes
  *
@@ -250,6 +384,1184 @@ static void test_xml_parse_attributes() {
 
 
 
+/**
+ * Test parsing of attributes whose values contain whitespace or `>' and which
+ * use both quote styles
+ */
+static void test_xml_parse_attributes_1() {
+	SOURCE(source, "<Test a = 'x y>z' b=\"it's\"\n\tc='\"'/>");
+	struct xml_document* document = xml_parse_document(source, strlen(source));
+	assert_that(document, "Could not parse document");
+
+	struct xml_node* root = xml_document_root(document);
+	assert_that(string_equals(xml_node_name(root), "Test"), "root node name must be `Test'");
+	assert_that(3 == xml_node_attributes(root), "Should have 3 attributes");
+	assert_that(0 == xml_node_children(root), "Self closing tag must not have children");
+
+	assert_that(string_equals(xml_node_attribute_name(root, 0), "a"), "First attribute's name should be a");
+	assert_that(string_equals(xml_node_attribute_content(root, 0), "x y>z"), "First attribute's content should be `x y>z'");
+	assert_that(string_equals(xml_node_attribute_name(root, 1), "b"), "Second attribute's name should be b");
+	assert_that(string_equals(xml_node_attribute_content(root, 1), "it's"), "Second attribute's content should be `it's'");
+	assert_that(string_equals(xml_node_attribute_name(root, 2), "c"), "Third attribute's name should be c");
+	assert_that(string_equals(xml_node_attribute_content(root, 2), "\""), "Third attribute's content should be `\"'");
+
+	xml_document_free(document, true);
+}
+
+
+
+/**
+ * Tests interning of element and attribute names
+ */
+static void test_xml_symbols() {
+	SOURCE(source, ""
+		"<Root>"
+			"<Item id=\"1\"><Name>a</Name></Item>"
+			"<Item Name=\"2\"><Name>b</Name></Item>"
+			"<Single>c</Single>"
+		"</Root>"
+	);
+	struct xml_document* document = xml_parse_document(source, strlen(source));
+	assert_that(document, "Could not parse document");
+
+	struct xml_node* root = xml_document_root(document);
+	uint32_t item = xml_document_symbol(document, "Item", strlen("Item"));
+	uint32_t name = xml_document_symbol(document, "Name", strlen("Name"));
+	uint32_t single = xml_document_symbol(document, "Single", strlen("Single"));
+
+	assert_that(item && name && single, "all names must have symbols");
+	assert_that((item != name) && (item != single) && (name != single), "distinct names must have distinct symbols");
+	assert_that(!xml_document_symbol(document, "Missing", strlen("Missing")), "unknown name must not have a symbol");
+	assert_that(!xml_document_symbol(document, "Nam", strlen("Nam")), "prefix must not have a symbol");
+
+	assert_that(item == xml_node_symbol(xml_node_child(root, 0)), "first child must be `Item'");
+	assert_that(item == xml_node_symbol(xml_node_child(root, 1)), "second child must be `Item'");
+	assert_that(name == xml_node_symbol(xml_node_child(xml_node_child(root, 1), 0)), "grandchild must be `Name'");
+
+	assert_that(!xml_node_child_by_symbol(root, item), "`Item' is not unique");
+	assert_that(!xml_node_child_by_symbol(root, 0), "symbol 0 must not match");
+	assert_that(xml_node_child(root, 2) == xml_node_child_by_symbol(root, single), "`Single' must be found by symbol");
+
+	assert_that(xml_node_child(root, 2) == xml_easy_child(root, "Single", 0), "`Single' must be found by name");
+	assert_that(!xml_easy_child(root, "Item", "Name", 0), "`Item' is not unique");
+	assert_that(!xml_easy_child(root, "Missing", 0), "`Missing' must not be found");
+
+	assert_that(string_equals(xml_node_attribute_name(xml_node_child(root, 1), 0), "Name"), "attribute name must be `Name'");
+
+	xml_document_free(document, true);
+}
+
+
+
+/**
+ * Tests lookups by name on a node large enough to get a child index
+ */
+static void test_xml_named_children() {
+	size_t const children = 1000;
+	char const* const names[] = {"a", "bb", "ccc", "dddd", "unique"};
+
+	uint8_t* source = calloc(children * 32, sizeof(uint8_t));
+	size_t length = sprintf(source, "<Root>");
+	size_t i = 0; for (; i < children; ++i) {
+		char const* name = (i == children / 2 + 2) ? names[4] : names[i % 4];
+		length += sprintf(source + length, "<%s>%i</%s>", name, (int)i, name);
+	}
+	length += sprintf(source + length, "</Root>");
+
+	struct xml_document* document = xml_parse_document(source, length);
+	assert_that(document, "Could not parse document");
+	struct xml_node* root = xml_document_root(document);
+	size_t memory = xml_document_memory(document);
+
+	uint32_t a = xml_document_symbol(document, "a", strlen("a"));
+	uint32_t ccc = xml_document_symbol(document, "ccc", strlen("ccc"));
+	uint32_t unique = xml_document_symbol(document, "unique", strlen("unique"));
+
+	assert_that(children / 4 == xml_node_named_children(root, a), "every 4th child must be `a'");
+	assert_that(children / 4 - 1 == xml_node_named_children(root, ccc), "`unique' replaces one `ccc'");
+	assert_that(1 == xml_node_named_children(root, unique), "`unique' must be unique");
+	assert_that(!xml_node_named_children(root, xml_document_symbol(document, "Root", strlen("Root"))), "`Root' is no child");
+	assert_that(memory < xml_document_memory(document), "index must be accounted in document memory");
+
+	assert_that(xml_node_child(root, 2) == xml_node_named_child(root, ccc, 0), "first `ccc' must be third child");
+	assert_that(xml_node_child(root, 6) == xml_node_named_child(root, ccc, 1), "second `ccc' must be seventh child");
+	assert_that(!xml_node_named_child(root, ccc, children / 4 - 1), "`ccc' out of range");
+
+	assert_that(xml_node_child(root, children / 2 + 2) == xml_easy_child(root, "unique", 0), "`unique' must be found by name");
+	assert_that(string_equals(xml_node_content(xml_node_child_by_symbol(root, unique)), "502"), "`unique' content must be 502");
+	assert_that(!xml_easy_child(root, "a", 0), "`a' is not unique");
+
+	xml_document_free(document, true);
+}
+
+
+
+/**
+ * @return true iff both subtrees have equal names, attributes, contents and
+ *     children
+ */
+static _Bool xml_string_same(struct xml_string* a, struct xml_string* b) {
+	if (!a || !b) {
+		return a == b;
+	}
+
+	size_t length = xml_string_length(a);
+	if (length != xml_string_length(b)) {
+		return false;
+	}
+
+	uint8_t* a_buffer = alloca(length + 1);
+	uint8_t* b_buffer = alloca(length + 1);
+	xml_string_copy(a, a_buffer, length);
+	xml_string_copy(b, b_buffer, length);
+	return !memcmp(a_buffer, b_buffer, length);
+}
+
+static _Bool nodes_equal(struct xml_node* a, struct xml_node* b) {
+	if (		!xml_string_same(xml_node_name(a), xml_node_name(b))
+		||	!xml_string_same(xml_node_content(a), xml_node_content(b))
+		||	(xml_node_attributes(a) != xml_node_attributes(b))
+		||	(xml_node_children(a) != xml_node_children(b))) {
+		return false;
+	}
+
+	size_t i = 0; for (; i < xml_node_attributes(a); ++i) {
+		if (		!xml_string_same(xml_node_attribute_name(a, i), xml_node_attribute_name(b, i))
+			||	!xml_string_same(xml_node_attribute_content(a, i), xml_node_attribute_content(b, i))) {
+			return false;
+		}
+	}
+	for (i = 0; i < xml_node_children(a); ++i) {
+		if (!nodes_equal(xml_node_child(a, i), xml_node_child(b, i))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+/**
+ * Tests on demand materialization of lazily parsed documents
+ */
+static void test_xml_parse_lazy() {
+	struct xml_options lazy = {0};
+	lazy.lazy = true;
+
+	SOURCE(source, ""
+		"<Root version=\"1\">\n"
+			"\t<Header a='x>y' b=\"<\"/>\n"
+			"\t<Body>\n"
+				"\t\t<Item id=\"1\"><Name>a</Name><Empty/></Item>\n"
+				"\t\t<Item id='2'><Name>b</Name><Note>some text</Note></Item>\n"
+			"\t</Body>\n"
+			"\t<Footer>end</Footer>\n"
+		"</Root>"
+	);
+
+	struct xml_document* eager = xml_parse_document(source, strlen(source));
+	struct xml_document* document = xml_parse_document_ex(source, strlen(source), &lazy);
+	assert_that(eager && document, "Could not parse document");
+
+	struct xml_node* root = xml_document_root(document);
+	assert_that(string_equals(xml_node_name(root), "Root"), "root node name must be `Root'");
+	assert_that(string_equals(xml_node_content(xml_easy_child(root, "Footer", 0)), "end"), "footer content must be `end'");
+	assert_that(nodes_equal(xml_document_root(eager), root), "lazy document must equal eager document");
+
+	xml_document_free(document, false);
+	xml_document_free(eager, true);
+
+	/* Skipped elements are checked against the same grammar, so both
+	 * accept and reject the same documents at the same offsets
+	 */
+	char const* const inputs[] = {
+		"<r><text\"/></r>",
+		"<Root><Broken>text<Child/></Broken><Fine>ok</Fine></Root>",
+		"<Root><a><b/>text</a></Root>",
+		"<Root><a>text</a>tail</Root>",
+		"<Root><a><b></b></Root>",
+		"<Root><a></b></Root>",
+		"<Root><a x=1/></Root>",
+		"<Root><a x='1' y></a></Root>",
+		"<Root><a/ ></Root>",
+		"<Root><a></ ></a></Root>",
+		"<Root><a><!-- comment --></a></Root>",
+		"<Root><a>",
+		"<Root><a b='>'>x</a  ></Root>",
+		"<Root><a><b c=\"&amp;\">&lt;</b><d/></a>\n</Root>",
+	};
+	size_t i = 0; for (; i < sizeof(inputs) / sizeof(inputs[0]); ++i) {
+		struct xml_error eager_error, lazy_error;
+		struct xml_options options = {0};
+
+		SOURCE(eager_source, inputs[i]);
+		options.error = &eager_error;
+		eager = xml_parse_document_ex(eager_source, strlen(eager_source), &options);
+
+		SOURCE(lazy_source, inputs[i]);
+		options.error = &lazy_error;
+		options.lazy = true;
+		document = xml_parse_document_ex(lazy_source, strlen(lazy_source), &options);
+
+		assert_that(!eager == !document, "lazy parsing must accept exactly what eager parsing accepts");
+		assert_that(eager_error.code == lazy_error.code, "lazy parsing must report the same error");
+		assert_that(document || (eager_error.offset == lazy_error.offset), "lazy parsing must report errors at the same offset");
+		assert_that(document || !strcmp(eager_error.path, lazy_error.path), "lazy parsing must report errors at the same path");
+
+		if (document) {
+			assert_that(nodes_equal(xml_document_root(eager), xml_document_root(document)), "lazy document must equal eager document");
+			assert_that(XML_ERROR_NONE == xml_document_error(document)->code, "materializing must not fail");
+			xml_document_free(document, false);
+			xml_document_free(eager, false);
+		}
+		free(lazy_source);
+		free(eager_source);
+	}
+
+	SOURCE(deep, "<a><a><a></a></a></a>");
+	lazy.max_depth = 2;
+	assert_that(!xml_parse_document_ex(deep, strlen(deep), &lazy), "lazy parsing must respect the depth limit");
+	free(deep);
+}
+
+
+
+/**
+ * Parses a document large enough to be split between threads and compares the
+ * result with a sequential parse
+ */
+static void test_xml_parse_parallel() {
+	size_t const children = 60000;
+	struct xml_options parallel = {0};
+	parallel.threads = 4;
+
+	uint8_t* source = calloc(children * 128 + 64, sizeof(uint8_t));
+	size_t length = sprintf(source, "<Root a=\"1\">\n");
+	size_t i = 0; for (; i < children; ++i) {
+		if (i % 3) {
+			length += sprintf(source + length, "\t<Item%i id='%i' note=\"x>y\"><Name>n%i</Name><Empty/></Item%i>\n", (int)(i % 7), (int)i, (int)i, (int)(i % 7));
+		} else {
+			length += sprintf(source + length, "\t<Text%i>  some text %i  </Text%i>\n", (int)(i % 5), (int)i, (int)(i % 5));
+		}
+	}
+	length += sprintf(source + length, "</Root>");
+
+	struct xml_document* sequential = xml_parse_document(source, length);
+	struct xml_document* document = xml_parse_document_ex(source, length, &parallel);
+	assert_that(sequential && document, "Could not parse document");
+
+	struct xml_node* root = xml_document_root(document);
+	assert_that(children == xml_node_children(root), "root must have all children");
+	assert_that(nodes_equal(xml_document_root(sequential), root), "parallel parse must equal sequential parse");
+
+	for (i = 0; i < children; ++i) {
+		struct xml_node* a = xml_node_child(xml_document_root(sequential), i);
+		struct xml_node* b = xml_node_child(root, i);
+
+		assert_that(xml_node_symbol(a) == xml_node_symbol(b), "symbols must be assigned in document order");
+	}
+	assert_that(xml_document_symbol(document, "Name", strlen("Name")) == xml_document_symbol(sequential, "Name", strlen("Name")), "`Name' must have the same symbol");
+
+	xml_document_free(document, false);
+	xml_document_free(sequential, false);
+
+	/* `/>' in text throws off the estimated nesting levels, but not the
+	 * result
+	 */
+	memcpy(strstr(source, "some"), "/>", 2);
+	sequential = xml_parse_document(source, length);
+	document = xml_parse_document_ex(source, length, &parallel);
+	assert_that(sequential && document, "Could not parse document");
+	assert_that(nodes_equal(xml_document_root(sequential), xml_document_root(document)), "parallel parse must equal sequential parse");
+
+	xml_document_free(document, false);
+	xml_document_free(sequential, false);
+
+	/* Errors anywhere in the document are detected
+	 */
+	memcpy(source + length / 2 + strcspn(source + length / 2, "<") + 1, "Bad", 3);
+	assert_that(!xml_parse_document_ex(source, length, &parallel), "malformed document must be rejected");
+
+	/* Chunks starting within attribute values full of `<' must not be split
+	 * there
+	 */
+	length = sprintf(source, "<Root>\n");
+	for (i = 0; i < children; ++i) {
+		length += sprintf(source + length, "\t<Item id='%i' a=\"<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\" b='<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<</Item>'/>\n", (int)i);
+	}
+	length += sprintf(source + length, "</Root>");
+
+	sequential = xml_parse_document(source, length);
+	document = xml_parse_document_ex(source, length, &parallel);
+	assert_that(sequential && document, "Could not parse document");
+	assert_that(children == xml_node_children(xml_document_root(document)), "root must have all children");
+	assert_that(nodes_equal(xml_document_root(sequential), xml_document_root(document)), "parallel parse must equal sequential parse");
+	xml_document_free(document, false);
+
+	/* Threads of a pool parse any number of documents
+	 */
+	parallel.pool = xml_pool_create(&parallel);
+	assert_that(parallel.pool, "Could not create pool");
+
+	for (i = 0; i < 3; ++i) {
+		document = xml_parse_document_ex(source, length, &parallel);
+		assert_that(document, "Could not parse document using pool");
+		assert_that(nodes_equal(xml_document_root(sequential), xml_document_root(document)), "parse using pool must equal sequential parse");
+		xml_document_free(document, false);
+	}
+	xml_pool_free(parallel.pool);
+	xml_document_free(sequential, false);
+
+	free(source);
+}
+
+
+
+/**
+ * One parser context parses several documents, each replacing the previous
+ * one
+ */
+static void test_xml_document_parser() {
+	struct xml_document_parser* parser = xml_document_parser_create(0);
+	assert_that(parser, "Could not create parser");
+
+	/* Large enough for the arena to span several blocks
+	 */
+	size_t const children = 20000;
+	uint8_t* large = calloc(children * 64 + 64, sizeof(uint8_t));
+	size_t length = sprintf(large, "<Large>");
+	size_t i = 0; for (; i < children; ++i) {
+		length += sprintf(large + length, "<Item id='%i'>%i</Item>", (int)i, (int)i);
+	}
+	length += sprintf(large + length, "</Large>");
+
+	uint8_t small[] = "<Small><Name>x</Name><Value a=\"1\"/></Small>";
+	uint8_t malformed[] = "<Small><Name>x</Small>";
+
+	size_t round = 0; for (; round < 3; ++round) {
+		struct xml_document* document = xml_document_parser_parse(parser, large, length);
+		struct xml_document* expected = xml_parse_document(large, length);
+		assert_that(document && expected, "Could not parse large document");
+		assert_that(nodes_equal(xml_document_root(expected), xml_document_root(document)), "reused parser must equal fresh parser");
+		xml_document_free(expected, false);
+
+		/* Names of the previous document are forgotten
+		 */
+		document = xml_document_parser_parse(parser, small, sizeof(small) - 1);
+		assert_that(document, "Could not parse small document");
+		assert_that(xml_document_symbol(document, "Small", strlen("Small")) == 1, "symbols must start over");
+		assert_that(!xml_document_symbol(document, "Item", strlen("Item")), "`Item' must be forgotten");
+
+		struct xml_node* name = xml_node_child(xml_document_root(document), 0);
+		assert_that(xml_node_set_content(name, "y", 1), "Could not modify document");
+		uint8_t output[64] = {0};
+		size_t written = xml_document_write_buffer(document, output, sizeof(output));
+		assert_that(written && !strcmp(output, "<Small><Name>y</Name><Value a=\"1\"/></Small>"), "modified document must be written");
+
+		assert_that(!xml_document_parser_parse(parser, malformed, sizeof(malformed) - 1), "malformed document must be rejected");
+	}
+	xml_document_parser_free(parser);
+
+	/* Threads are kept by the context
+	 */
+	struct xml_options threaded = {0};
+	threaded.threads = 4;
+	parser = xml_document_parser_create(&threaded);
+	assert_that(parser, "Could not create parser");
+
+	struct xml_document* expected = xml_parse_document(large, length);
+	for (round = 0; round < 3; ++round) {
+		struct xml_document* document = xml_document_parser_parse(parser, large, length);
+		assert_that(document && expected, "Could not parse large document");
+		assert_that(nodes_equal(xml_document_root(expected), xml_document_root(document)), "threaded parser must equal fresh parser");
+	}
+	xml_document_free(expected, false);
+	xml_document_parser_free(parser);
+
+	free(large);
+}
+
+
+
+/**
+ * Allocator counting its live allocations, fails once `limit' allocations
+ * have been made if set
+ */
+struct counting_allocator {
+	size_t allocations;
+	size_t live;
+	size_t limit;
+};
+
+static void* counting_alloc(void* context, size_t size) {
+	struct counting_allocator* counter = context;
+	if (counter->limit && (counter->allocations >= counter->limit)) {
+		return 0;
+	}
+	counter->allocations++;
+	counter->live++;
+	return malloc(size);
+}
+
+static void* counting_realloc(void* context, void* memory, size_t size) {
+	(void)context;
+	return realloc(memory, size);
+}
+
+static void counting_free(void* context, void* memory) {
+	struct counting_allocator* counter = context;
+	counter->live--;
+	free(memory);
+}
+
+
+
+/**
+ * All memory of a document, reader, push parser or query comes from its
+ * allocator and is returned to it
+ */
+static void test_xml_allocator() {
+	struct counting_allocator counter = {0};
+	struct xml_allocator allocator = {counting_alloc, counting_realloc, counting_free, &counter};
+	struct xml_options options = {0};
+	options.allocator = &allocator;
+
+	uint8_t source[] = "<Root><Item id='1'>a</Item><Item id='2'>b</Item></Root>";
+	struct xml_document* document = xml_parse_document_ex(source, sizeof(source) - 1, &options);
+	assert_that(document, "Could not parse document");
+	assert_that(counter.allocations && counter.live, "document must be allocated by the allocator");
+
+	assert_that(xml_node_set_content(xml_node_child(xml_document_root(document), 0), "c", 1), "Could not modify document");
+
+	/* Queries and their iterators
+	 */
+	size_t allocations = counter.allocations;
+	size_t live = counter.live;
+	struct xml_query* query = xml_query_compile_ex("//Item", &options);
+	assert_that(query && (counter.live > live), "query must be allocated by the allocator");
+	live = counter.live;
+
+	struct xml_query_iterator* iterator = xml_query_iterate(query, xml_document_root(document));
+	assert_that(iterator && (counter.live > live), "iterator must be allocated by the document's allocator");
+	assert_that(xml_query_next(iterator), "Could not query document");
+	xml_query_iterator_free(iterator);
+	xml_query_free(query);
+
+	xml_document_free(document, false);
+	assert_that(!counter.live, "all memory must be returned to the allocator");
+
+	/* Readers and push parsers
+	 */
+	struct xml_reader_callbacks callbacks = {0};
+	allocations = counter.allocations;
+	struct xml_reader* reader = xml_reader_create_ex(&callbacks, 0, &options);
+	assert_that(reader && (XML_READER_SUCCESS == xml_reader_parse(reader, source, sizeof(source) - 1)), "Could not read document");
+	xml_reader_free(reader);
+
+	struct xml_push_parser* push_parser = xml_push_parser_create_ex(&callbacks, 0, &options);
+	assert_that(push_parser && (XML_READER_SUCCESS == xml_push_parser_feed(push_parser, source, sizeof(source) - 1)), "Could not push document");
+	assert_that(XML_READER_SUCCESS == xml_push_parser_finish(push_parser), "Could not finish document");
+	xml_push_parser_free(push_parser);
+	assert_that(counter.allocations > allocations + 4, "reader and push parser must be allocated by the allocator");
+	assert_that(!counter.live, "reader and push parser memory must be returned to the allocator");
+
+	/* The buffer of a stream is allocated and released by the allocator as
+	 * well
+	 */
+	FILE* file = tmpfile();
+	assert_that(file, "Could not create temporary file");
+	fwrite(source, 1, sizeof(source) - 1, file);
+	rewind(file);
+
+	allocations = counter.allocations;
+	document = xml_open_document_ex(file, &options);
+	assert_that(document, "Could not open document");
+	assert_that(counter.allocations > allocations + 1, "buffer must be allocated by the allocator");
+	xml_document_free(document, true);
+	assert_that(!counter.live, "buffer must be returned to the allocator");
+
+	/* Lazy documents allocate while being accessed
+	 */
+	options.lazy = true;
+	document = xml_parse_document_ex(source, sizeof(source) - 1, &options);
+	assert_that(document && (2 == xml_node_children(xml_document_root(document))), "Could not parse document lazily");
+	assert_that(XML_ERROR_NONE == xml_document_error(document)->code, "materializing must succeed");
+
+	/* Running out of memory while materializing is reported by the document
+	 */
+	counter.limit = counter.allocations;
+	struct xml_node* item = xml_node_child(xml_document_root(document), 1);
+	assert_that(!xml_node_content(item) && !xml_node_attributes(item), "node must be empty if it cannot be materialized");
+	assert_that(XML_ERROR_OUT_OF_MEMORY == xml_document_error(document)->code, "failed materialization must be reported");
+	counter.limit = 0;
+
+	xml_document_free(document, false);
+	assert_that(!counter.live, "lazily parsed memory must be returned to the allocator");
+}
+
+
+
+/**
+ * Failures are reported as structured errors instead of being printed
+ */
+static void test_xml_error() {
+	struct xml_error error;
+	struct xml_options options = {0};
+	options.error = &error;
+
+	SOURCE(source, ""
+		"<Root>\n"
+		"\t<Item>\n"
+		"\t\t<Name>x</Nam>\n"
+		"\t</Item>\n"
+		"</Root>"
+	);
+	assert_that(!xml_parse_document_ex(source, strlen(source), &options), "tag missmatch must be rejected");
+	assert_that(XML_ERROR_TAG_MISMATCH == error.code, "tag missmatch must be reported as such");
+	assert_that(!strcmp("/Root/Item/Name", error.path), "open elements must be reported");
+	assert_that(error.message && strstr(error.message, "missmatch"), "message must describe the error");
+
+	size_t line = 0;
+	size_t column = 0;
+	xml_error_position(&error, source, &line, &column);
+	assert_that((3 == line) && (16 == column), "position must point behind the closing tag");
+
+	/* Success resets the error
+	 */
+	SOURCE(valid, "<Root/>");
+	struct xml_document* document = xml_parse_document_ex(valid, strlen(valid), &options);
+	assert_that(document && (XML_ERROR_NONE == error.code), "valid document must not report an error");
+	xml_document_free(document, false);
+
+	assert_that(!xml_parse_document_ex(valid, 0, &options), "empty document must be rejected");
+	assert_that(XML_ERROR_EMPTY_DOCUMENT == error.code, "empty document must be reported as such");
+
+	options.max_depth = 2;
+	assert_that(!xml_parse_document_ex(source, strlen(source), &options), "deep document must be rejected");
+	assert_that(XML_ERROR_MAXIMUM_DEPTH == error.code, "maximum depth must be reported as such");
+
+	free(valid);
+	free(source);
+}
+
+
+
+/**
+ * Validation accepts exactly the documents the parser accepts
+ */
+static void test_xml_validate() {
+	char const* documents[] = {
+		"<Root/>",
+		"<Root a=\"1\" b='2'><Child>text</Child><Empty /></Root>",
+		"  <Root>\n\t<A><B><C/></B></A>\n</Root>  ",
+		"<Root><A></B></Root>",
+		"<Root><A>",
+		"<Root a=1/>",
+		"<Root a=\"1></Root>",
+		"<Root>text<Child/></Root>",
+		"</Root>",
+		"text",
+	};
+
+	size_t i = 0; for (; i < sizeof(documents) / sizeof(documents[0]); ++i) {
+		SOURCE(source, documents[i]);
+		size_t length = strlen(source);
+
+		struct xml_document* document = xml_parse_document(source, length);
+		struct xml_error error;
+		bool valid = xml_validate(source, length, &error);
+
+		assert_that(valid == (0 != document), "validation must agree with parser");
+		assert_that(valid == (XML_ERROR_NONE == error.code), "error must be reported iff invalid");
+		if (document) {
+			xml_document_free(document, false);
+		}
+		free(source);
+	}
+
+	SOURCE(mismatch, "<Root><A><B></A></B></Root>");
+	struct xml_error error;
+	assert_that(!xml_validate(mismatch, strlen(mismatch), &error), "tag missmatch must be rejected");
+	assert_that((XML_ERROR_TAG_MISMATCH == error.code) && !strcmp("/Root/A/B", error.path), "tag missmatch must be reported with open elements");
+	assert_that(!xml_validate(mismatch, 0, 0), "empty document must be rejected");
+	free(mismatch);
+
+	/* Attribute counts are not limited to 16 bit
+	 */
+	size_t const attributes = 70000;
+	uint8_t* many = calloc(attributes * 6 + 16, sizeof(uint8_t));
+	assert_that(many, "out of memory");
+	size_t length = sprintf(many, "<Root");
+	for (i = 0; i < attributes; ++i) {
+		length += sprintf(&many[length], " a=\"1\"");
+	}
+	length += sprintf(&many[length], "/>");
+
+	assert_that(xml_validate(many, length, 0), "many attributes must be valid");
+	struct xml_document* document = xml_parse_document(many, length);
+	assert_that(document, "many attributes must be parsed");
+	assert_that(attributes == xml_node_attributes(xml_document_root(document)), "all attributes must be kept");
+	xml_document_free(document, true);
+}
+
+
+
+/**
+ * Batches of documents are parsed on several threads, results keep the order
+ * of the inputs
+ */
+static void test_xml_parse_batch() {
+	size_t const documents = 1000;
+	struct xml_batch_input* inputs = calloc(documents, sizeof(struct xml_batch_input));
+	struct xml_batch_output* outputs = calloc(documents, sizeof(struct xml_batch_output));
+	uint8_t* buffer = calloc(documents, 64);
+	assert_that(inputs && outputs && buffer, "out of memory");
+
+	size_t i = 0; for (; i < documents; ++i) {
+		inputs[i].buffer = &buffer[i * 64];
+		if (i % 7) {
+			inputs[i].length = sprintf(inputs[i].buffer, "<Document><Id>%i</Id></Document>", (int)i);
+		} else {
+			inputs[i].length = sprintf(inputs[i].buffer, "<Document><Id>%i</Document>", (int)i);
+		}
+	}
+
+	/* Sequentially, on threads started for the batch and on a pool with fewer
+	 * threads than shares
+	 */
+	size_t round = 0; for (; round < 3; ++round) {
+		struct xml_options options = {0};
+		options.threads = (round == 1) ? 4 : 0;
+		if (round == 2) {
+			options.threads = 2;
+			options.pool = xml_pool_create(&options);
+			assert_that(options.pool, "Could not create pool");
+			options.threads = 8;
+		}
+
+		size_t parsed = xml_parse_batch(inputs, documents, outputs, &options);
+		assert_that(documents - (documents + 6) / 7 == parsed, "all well-formed documents must be parsed");
+
+		for (i = 0; i < documents; ++i) {
+			if (i % 7) {
+				char expected[16];
+				sprintf(expected, "%i", (int)i);
+
+				struct xml_node* id = xml_node_child(xml_document_root(outputs[i].document), 0);
+				assert_that(string_equals(xml_node_content(id), expected), "results must be in input order");
+				assert_that(XML_ERROR_NONE == outputs[i].error.code, "no error must be reported for parsed documents");
+				assert_that(outputs[i].seconds >= 0, "latency must be reported");
+				xml_document_free(outputs[i].document, false);
+			} else {
+				assert_that(!outputs[i].document, "malformed document must be rejected");
+				assert_that(XML_ERROR_TAG_MISMATCH == outputs[i].error.code, "error must be reported per document");
+			}
+		}
+
+		if (options.pool) {
+			xml_pool_free(options.pool);
+		}
+	}
+
+	free(buffer);
+	free(outputs);
+	free(inputs);
+}
+
+
+
+/**
+ * @return true iff the document written into a buffer equals `expected'
+ */
+static _Bool document_equals(struct xml_document* document, char const* expected) {
+	size_t length = xml_document_write_buffer(document, 0, 0);
+	uint8_t* buffer = calloc(length + 1, sizeof(uint8_t));
+
+	_Bool equal =		(length == xml_document_write_buffer(document, buffer, length))
+			&&	(length == strlen(expected))
+			&&	!memcmp(buffer, expected, length);
+
+	free(buffer);
+	return equal;
+}
+
+
+
+/**
+ * Decodes entity and character references in place while parsing and on
+ * demand
+ */
+static void test_xml_decode() {
+	struct xml_options decode = {0};
+	decode.decode = true;
+
+	SOURCE(source, ""
+		"<Root v=\"&lt;&#x20AC;&#169;&quot;\" plain='text'>\n"
+			"\t<A>fish &amp; chips</A>\n"
+			"\t<B>&foo; &amp &#0; &#xD800; &#; &#x110000; & done</B>\n"
+			"\t<C>no references</C>\n"
+		"</Root>"
+	);
+	size_t length = strlen(source);
+
+	/* Raw strings are decoded on demand
+	 */
+	struct xml_document* document = xml_parse_document(source, length);
+	assert_that(document, "Could not parse document");
+	struct xml_node* root = xml_document_root(document);
+
+	struct xml_string* fish = xml_node_content(xml_node_child(root, 0));
+	assert_that(string_equals(fish, "fish &amp; chips"), "content must be raw by default");
+
+	uint8_t decoded[32];
+	assert_that(12 == xml_string_decode(fish, decoded, sizeof(decoded)), "decoded content must be shorter");
+	assert_that(!memcmp(decoded, "fish & chips", 12), "`&amp;' must be decoded");
+
+	memset(decoded, 0, sizeof(decoded));
+	assert_that(12 == xml_string_decode(fish, decoded, 6), "decoded length must not depend on the buffer");
+	assert_that(!memcmp(decoded, "fish &", 6) && !decoded[6], "at most `length' bytes must be written");
+	xml_document_free(document, false);
+
+	/* Decoding in place
+	 */
+	document = xml_parse_document_ex(source, length, &decode);
+	assert_that(document, "Could not parse document");
+	root = xml_document_root(document);
+
+	assert_that(string_equals(xml_node_attribute_content(root, 0), "<\xE2\x82\xAC\xC2\xA9\""), "references in attributes must be decoded");
+	assert_that(string_equals(xml_node_attribute_content(root, 1), "text"), "plain attribute must be unchanged");
+	assert_that(string_equals(xml_node_content(xml_node_child(root, 0)), "fish & chips"), "references in content must be decoded");
+	assert_that(string_equals(xml_node_content(xml_node_child(root, 1)), "&foo; &amp &#0; &#xD800; &#; &#x110000; & done"), "invalid references must be kept");
+	assert_that(string_equals(xml_node_content(xml_node_child(root, 2)), "no references"), "plain content must be unchanged");
+	xml_document_free(document, true);
+
+	/* Lazy and parallel parsing decode the same way
+	 */
+	size_t const children = 60000;
+	uint8_t* buffers[3];
+	size_t i = 0; for (; i < 3; ++i) {
+		buffers[i] = calloc(children * 64 + 64, sizeof(uint8_t));
+		length = sprintf((char*)buffers[i], "<Root a=\"&amp;\">\n");
+
+		size_t j = 0; for (; j < children; ++j) {
+			length += sprintf((char*)buffers[i] + length, "\t<Item id='&#%i;'>%s</Item>\n", 65 + (int)(j % 26), (j % 3) ? "x &lt; y" : "plain");
+		}
+		length += sprintf((char*)buffers[i] + length, "</Root>");
+	}
+
+	struct xml_document* sequential = xml_parse_document_ex(buffers[0], length, &decode);
+	decode.lazy = true;
+	struct xml_document* lazy = xml_parse_document_ex(buffers[1], length, &decode);
+	decode.lazy = false;
+	decode.threads = 4;
+	struct xml_document* parallel = xml_parse_document_ex(buffers[2], length, &decode);
+	assert_that(sequential && lazy && parallel, "Could not parse document");
+
+	root = xml_document_root(sequential);
+	assert_that(string_equals(xml_node_attribute_content(root, 0), "&"), "root attribute must be decoded");
+	assert_that(string_equals(xml_node_attribute_content(xml_node_child(root, 1), 0), "B"), "character reference must be decoded");
+	assert_that(string_equals(xml_node_content(xml_node_child(root, 1)), "x < y"), "entity must be decoded");
+	assert_that(nodes_equal(root, xml_document_root(lazy)), "lazy document must be decoded alike");
+	assert_that(nodes_equal(root, xml_document_root(parallel)), "parallel document must be decoded alike");
+
+	/* Decoded nodes are recorded by every parser, so all documents are
+	 * written back alike
+	 */
+	size_t written = xml_document_write_buffer(sequential, 0, 0);
+	uint8_t* expected = calloc(written + 1, sizeof(uint8_t));
+	assert_that(expected && (written == xml_document_write_buffer(sequential, expected, written)), "Could not write document");
+	assert_that(strstr(expected, "<Item id=\"B\">x &lt; y</Item>"), "decoded nodes must be written anew");
+	assert_that(document_equals(lazy, expected), "lazy document must be written alike");
+	assert_that(document_equals(parallel, expected), "parallel document must be written alike");
+	free(expected);
+
+	xml_document_free(sequential, true);
+	xml_document_free(lazy, true);
+	xml_document_free(parallel, true);
+}
+
+
+
+/**
+ * Writes documents back, only modified nodes may differ from their source
+ */
+static void test_xml_write() {
+	char const* markup = "\n"
+		"  <Root a='x \"quoted\"'>\n"
+			"\t<A id=\"1\">one</A>\n"
+			"\t<B   id=\"2\"><C>deep</C>  <D/></B>\n"
+			"\t<E>fish &amp; chips</E>\n"
+		"</Root>\n";
+	SOURCE(source, markup);
+	size_t length = strlen(markup);
+
+	struct xml_document* document = xml_parse_document(source, length);
+	assert_that(document, "Could not parse document");
+	struct xml_node* root = xml_document_root(document);
+
+	/* Unmodified documents are their buffer
+	 */
+	struct iovec iovecs[16];
+	assert_that(document_equals(document, markup), "unmodified document must be written as is");
+	assert_that(1 == xml_document_iovec(document, iovecs, 16), "unmodified document must be a single chunk");
+	assert_that((source == iovecs[0].iov_base) && (length == iovecs[0].iov_len), "chunk must reference the buffer");
+
+	/* Modified nodes and their ancestors are written anew
+	 */
+	assert_that(!xml_node_set_content(root, (uint8_t const*)"text", 4), "nodes with children cannot have content");
+	assert_that(!xml_node_set_attribute_content(root, 1, (uint8_t const*)"", 0), "attribute must be in range");
+	assert_that(document_equals(document, markup), "failed modifications must not change the document");
+
+	assert_that(xml_node_set_content(xml_node_child(root, 0), (uint8_t const*)"uno", 3), "Could not set content");
+	assert_that(xml_node_set_content(xml_easy_child(root, (uint8_t const*)"B", (uint8_t const*)"C", 0), (uint8_t const*)"tief", 4), "Could not set content");
+	assert_that(string_equals(xml_node_content(xml_node_child(root, 0)), "uno"), "content must be replaced");
+
+	char const* expected = "\n"
+		"  <Root a=\"x &quot;quoted&quot;\">\n"
+			"\t<A id=\"1\">uno</A>\n"
+			"\t<B id=\"2\"><C>tief</C>  <D/></B>\n"
+			"\t<E>fish &amp; chips</E>\n"
+		"</Root>\n";
+	assert_that(document_equals(document, expected), "modified document must keep unmodified markup");
+
+	size_t chunks = xml_document_iovec(document, iovecs, 16);
+	assert_that(chunks > 16, "chunks must be counted beyond the capacity");
+	struct iovec* all = calloc(chunks, sizeof(struct iovec));
+	assert_that(chunks == xml_document_iovec(document, all, chunks), "chunks must be counted alike");
+
+	uint8_t const* tail = (uint8_t const*)strstr((char*)source, "</B>") + 4;
+	size_t j = 0; while ((j < chunks) && (tail != all[j].iov_base)) {
+		j++;
+	}
+	assert_that((j < chunks) && (strlen("\n\t<E>fish &amp; chips</E>\n") == all[j].iov_len), "unmodified siblings and whitespace must be one chunk of the buffer");
+	free(all);
+
+	/* Streams and file descriptors receive the same bytes
+	 */
+	char written[256] = {0};
+	FILE* file = tmpfile();
+	assert_that(file && xml_document_write(document, file), "Could not write document to stream");
+	rewind(file);
+	assert_that(strlen(expected) == fread(written, 1, sizeof(written), file), "stream must contain the document");
+	assert_that(!strcmp(written, expected), "stream must contain the document");
+	fclose(file);
+
+	int descriptors[2];
+	memset(written, 0, sizeof(written));
+	assert_that(!pipe(descriptors), "Could not create pipe");
+	assert_that(xml_document_write_fd(document, descriptors[1]), "Could not write document to descriptor");
+	close(descriptors[1]);
+	assert_that(strlen(expected) == (size_t)read(descriptors[0], written, sizeof(written)), "pipe must contain the document");
+	assert_that(!strcmp(written, expected), "pipe must contain the document");
+	close(descriptors[0]);
+	xml_document_free(document, true);
+
+	/* Decoded strings are escaped again
+	 */
+	struct xml_options options = {0};
+	options.decode = true;
+
+	SOURCE(decoded, markup);
+	document = xml_parse_document_ex(decoded, length, &options);
+	assert_that(document, "Could not parse document");
+	root = xml_document_root(document);
+
+	assert_that(xml_node_set_attribute_content(xml_node_child(root, 0), 0, (uint8_t const*)"<&>", 3), "Could not set attribute");
+	expected = "\n"
+		"  <Root a=\"x &quot;quoted&quot;\">\n"
+			"\t<A id=\"&lt;&amp;&gt;\">one</A>\n"
+			"\t<B   id=\"2\"><C>deep</C>  <D/></B>\n"
+			"\t<E>fish &amp; chips</E>\n"
+		"</Root>\n";
+	assert_that(document_equals(document, expected), "decoded strings must be escaped");
+	xml_document_free(document, true);
+
+	/* Lazy and parallel documents are written alike
+	 */
+	size_t const children = 60000;
+	uint8_t* buffers[3];
+	size_t i = 0; for (; i < 3; ++i) {
+		buffers[i] = calloc(children * 64 + 64, sizeof(uint8_t));
+		length = sprintf((char*)buffers[i], "<Root>\n");
+
+		size_t j = 0; for (; j < children; ++j) {
+			length += sprintf((char*)buffers[i] + length, "\t<Item id='%i'><Name>n%i</Name></Item>\n", (int)j, (int)j);
+		}
+		length += sprintf((char*)buffers[i] + length, "</Root>");
+	}
+
+	options.decode = false;
+	struct xml_document* sequential = xml_parse_document_ex(buffers[0], length, &options);
+	options.lazy = true;
+	struct xml_document* lazy = xml_parse_document_ex(buffers[1], length, &options);
+	options.lazy = false;
+	options.threads = 4;
+	struct xml_document* parallel = xml_parse_document_ex(buffers[2], length, &options);
+	assert_that(sequential && lazy && parallel, "Could not parse document");
+
+	struct xml_document* documents[3] = {sequential, lazy, parallel};
+	uint8_t* outputs[3];
+	for (i = 0; i < 3; ++i) {
+		struct xml_node* item = xml_node_child(xml_document_root(documents[i]), children / 2);
+		assert_that(xml_node_set_content(xml_node_child(item, 0), (uint8_t const*)"changed", 7), "Could not set content");
+		assert_that(xml_node_set_attribute_content(xml_node_child(xml_document_root(documents[i]), 0), 0, (uint8_t const*)"first", 5), "Could not set attribute");
+
+		outputs[i] = calloc(length + 64, sizeof(uint8_t));
+		assert_that(length + 5 == xml_document_write_buffer(documents[i], outputs[i], length + 64), "Only the modified strings may change the length");
+	}
+	assert_that(!memcmp(outputs[0], outputs[1], length + 5), "lazy document must be written alike");
+	assert_that(!memcmp(outputs[0], outputs[2], length + 5), "parallel document must be written alike");
+	assert_that(strstr((char*)outputs[0], "<Root>\n\t<Item id=\"first\"><Name>n0</Name></Item>\n\t<Item id='1'>"), "unmodified siblings must be kept");
+	assert_that(strstr((char*)outputs[0], "<Item id=\"30000\"><Name>changed</Name></Item>"), "modified node must be written");
+
+	for (i = 0; i < 3; ++i) {
+		xml_document_free(documents[i], true);
+		free(outputs[i]);
+	}
+}
+
+
+
+
+/**
+ * @return Number of elements the query matches below `node', the last one is
+ *     stored in `last'
+ */
+static size_t query_count(char const* expression, struct xml_node* node, struct xml_node** last) {
+	struct xml_query* query = xml_query_compile(expression);
+	assert_that(query, "Could not compile query");
+
+	struct xml_query_iterator* iterator = xml_query_iterate(query, node);
+	assert_that(iterator, "Could not run query");
+
+	size_t count = 0;
+	struct xml_node* match;
+	while ((match = xml_query_next(iterator))) {
+		*last = match;
+		count++;
+	}
+
+	xml_query_iterator_free(iterator);
+	xml_query_free(query);
+	return count;
+}
+
+
+
+/**
+ * Compiles queries and runs them against parsed and lazy documents
+ */
+static void test_xml_query() {
+	char const* malformed[] = {"", "/", "//", "a/", "a[", "a[]", "a[0]", "a[@]", "a[@b=c]", "a[@b='c]", "a]", "a b", "/a//"};
+	size_t i = 0; for (; i < sizeof(malformed) / sizeof(malformed[0]); ++i) {
+		assert_that(!xml_query_compile(malformed[i]), "malformed query must not compile");
+	}
+
+	char const* markup = ""
+		"<feed>"
+			"<item type=\"x\" id=\"1\"><price>1</price></item>"
+			"<item type=\"y\" id=\"2\"><price>2</price></item>"
+			"<other><item type=\"x\" id=\"3\"><price>3</price></item></other>"
+			"<item type=\"x\" id=\"4\"><price>4</price><item id=\"5\"/></item>"
+		"</feed>";
+
+	struct xml_options lazy = {0};
+	lazy.lazy = true;
+
+	size_t mode = 0; for (; mode < 2; ++mode) {
+		SOURCE(source, markup);
+		struct xml_document* document = xml_parse_document_ex(source, strlen(markup), mode ? &lazy : 0);
+		assert_that(document, "Could not parse document");
+		struct xml_node* root = xml_document_root(document);
+		struct xml_node* last = 0;
+
+		assert_that(1 == query_count("/feed", root, &last) && (root == last), "absolute query must select the node itself");
+		assert_that(0 == query_count("/item", root, &last), "absolute query must test the node itself");
+		assert_that(3 == query_count("item", root, &last), "relative query must start with the children");
+
+		assert_that(2 == query_count("/feed/item[@type='x']/price", root, &last), "attribute predicate must filter");
+		assert_that(string_equals(xml_node_content(last), "4"), "matches must be in document order");
+
+		assert_that(3 == query_count("//item[@type=\"x\"]/price", root, &last), "descendants must be searched");
+		assert_that(5 == query_count("//item", root, &last) && string_equals(xml_node_attribute_content(last, 0), "5"), "nested matches must be found once");
+		assert_that(4 == query_count("/feed/*", root, &last), "`*' must match any name");
+
+		assert_that(1 == query_count("/feed/item[2]", root, &last) && string_equals(xml_node_attribute_content(last, 1), "2"), "position must count siblings");
+		assert_that(1 == query_count("/feed/item[@type='x'][2]", root, &last) && string_equals(xml_node_attribute_content(last, 1), "4"), "position must count preceding matches only");
+		assert_that(0 == query_count("/feed/item[2][@type='x']", root, &last), "predicates must apply in order");
+		assert_that(3 == query_count("//item[1]", root, &last), "position must be relative to each parent");
+		assert_that(0 == query_count("//missing", root, &last), "unknown names must not match");
+		assert_that(0 == query_count("/feed/item[@missing]", root, &last), "missing attribute must not match");
+
+		xml_document_free(document, true);
+	}
+
+	/* Lazy documents only parse elements on matching paths
+	 */
+	SOURCE(source, markup);
+	struct xml_document* document = xml_parse_document_ex(source, strlen(markup), &lazy);
+	assert_that(document, "Could not parse document");
+
+	struct xml_node* last = 0;
+	assert_that(1 == query_count("/feed/other", xml_document_root(document), &last), "Could not find element");
+	size_t memory = xml_document_memory(document);
+
+	assert_that(4 == query_count("//price", xml_document_root(document), &last), "Could not find elements");
+	assert_that(memory < xml_document_memory(document), "non-matching subtrees must not have been parsed");
+	xml_document_free(document, true);
+}
+
+
+/**
+ * Records xml_reader events as text
+ */
+struct reader_events {
+	char text[1024];
+	size_t elements;
+	size_t abort_after;
+};
+
+static bool append_event(struct reader_events* events, char const* prefix, struct xml_string* string) {
+	size_t length = strlen(events->text);
+	size_t string_length = xml_string_length(string);
+
+	strcat(events->text, prefix);
+	xml_string_copy(string, (uint8_t*)&events->text[length + strlen(prefix)], string_length);
+	events->text[length + strlen(prefix) + string_length] = 0;
+	return true;
+}
+
+static bool on_start_element(void* context, struct xml_string* name) {
+	struct reader_events* events = context;
+
+	if (++events->elements == events->abort_after) {
+		return false;
+	}
+	return append_event(events, "<", name);
+}
+
+static bool on_attribute(void* context, struct xml_string* name, struct xml_string* content) {
+	append_event(context, " ", name);
+	return append_event(context, "=", content);
+}
+
+static bool on_text(void* context, struct xml_string* content) {
+	return append_event(context, "|", content);
+}
+
+static bool on_end_element(void* context, struct xml_string* name) {
+	return append_event(context, ">", name);
+}
+
+
+
+/**
+ * Tests the streaming xml_reader
+ */
+static void test_xml_reader() {
+	SOURCE(source, ""
+		"<Parent a=\"1\">\n"
+		"\t<Child b='2'>Content</Child>\n"
+		"\t<Empty/>\n"
+		"</Parent>\n"
+	);
+	struct xml_reader_callbacks const callbacks = {
+		.start_element = on_start_element,
+		.attribute = on_attribute,
+		.text = on_text,
+		.end_element = on_end_element,
+	};
+
+	struct reader_events events = {{0}, 0, 0};
+	struct xml_reader* reader = xml_reader_create(&callbacks, &events);
+	assert_that(reader, "Could not create reader");
+
+	assert_that(XML_READER_SUCCESS == xml_reader_parse(reader, source, strlen(source)), "Could not read document");
+	assert_that(!strcmp(events.text, "<Parent a=1<Child b=2|Content>Child<Empty>Empty>Parent"), "Unexpected reader events");
+	assert_that(3 == events.elements, "Reader must report three elements");
+
+	/* Abort while reading the second element
+	 */
+	events.text[0] = 0;
+	events.elements = 0;
+	events.abort_after = 2;
+	assert_that(XML_READER_ABORTED == xml_reader_parse(reader, source, strlen(source)), "Callback must abort reader");
+	assert_that(!strcmp(events.text, "<Parent a=1"), "Reader must stop after abort");
+
+	/* Malformed documents are reported as such
+	 */
+	SOURCE(malformed, "<Parent><Child></Parent></Child>");
+	events.abort_after = 0;
+	assert_that(XML_READER_ERROR == xml_reader_parse(reader, malformed, strlen(malformed)), "Reader must reject tag missmatch");
+	assert_that(XML_ERROR_TAG_MISMATCH == xml_reader_error(reader)->code, "Reader must report tag missmatch");
+	assert_that(!strcmp("/Parent/Child", xml_reader_error(reader)->path), "Reader must report open elements");
+
+	xml_reader_free(reader);
+	free(malformed);
+	free(source);
+}
+
+
+
+/**
+ * Tests the xml_push_parser by feeding the same document in chunks of every
+ * possible size
+ */
+static void test_xml_push_parser() {
+	SOURCE(source, ""
+		"<Parent a=\"1\" bb = 'two words'>\n"
+		"\t<Child b='2'>Content which is long enough to span more than a single vector</Child>\n"
+		"\t<Empty />\n"
+		"</Parent>\n"
+	);
+	char const* expected = "<Parent a=1 bb=two words<Child b=2|Content which is long enough to span more than a single vector>Child<Empty>Empty>Parent";
+
+	struct xml_reader_callbacks const callbacks = {
+		.start_element = on_start_element,
+		.attribute = on_attribute,
+		.text = on_text,
+		.end_element = on_end_element,
+	};
+
+	struct reader_events events = {{0}, 0, 0};
+	struct xml_push_parser* parser = xml_push_parser_create(&callbacks, &events);
+	assert_that(parser, "Could not create push parser");
+
+	size_t length = strlen(source);
+	size_t chunk = 1; for (; chunk <= length; ++chunk) {
+		events.text[0] = 0;
+
+		size_t position = 0; for (; position < length; position += chunk) {
+			size_t remaining = length - position;
+			enum xml_reader_result result = xml_push_parser_feed(parser, &source[position], chunk < remaining ? chunk : remaining);
+			assert_that(XML_READER_SUCCESS == result, "Push parser must accept every chunk");
+		}
+
+		assert_that(XML_READER_SUCCESS == xml_push_parser_finish(parser), "Push parser must complete document");
+		assert_that(!strcmp(events.text, expected), "Unexpected push parser events");
+	}
+
+	/* Incomplete documents are only detected when finishing
+	 */
+	assert_that(XML_READER_SUCCESS == xml_push_parser_feed(parser, source, length / 2), "Push parser must accept first half");
+	assert_that(XML_READER_ERROR == xml_push_parser_finish(parser), "Push parser must reject incomplete document");
+	assert_that(XML_ERROR_UNEXPECTED_END == xml_push_parser_error(parser)->code, "Push parser must report incomplete document");
+
+	/* Offsets count from the start of the document, not of the chunk
+	 */
+	SOURCE(malformed, "<Parent><Child></Other></Parent>");
+	assert_that(XML_READER_SUCCESS == xml_push_parser_feed(parser, malformed, 15), "Push parser must accept first chunk");
+	assert_that(XML_READER_ERROR == xml_push_parser_feed(parser, &malformed[15], strlen(malformed) - 15), "Push parser must reject tag missmatch");
+	assert_that(23 == xml_push_parser_error(parser)->offset, "Push parser must report offset within document");
+	xml_push_parser_finish(parser);
+	free(malformed);
+
+	xml_push_parser_free(parser);
+	free(source);
+}
+
+
+
 /**
  * Console interface
  */
@@ -258,7 +1570,25 @@ int main(int argc, char** argv) {
 	test_xml_parse_document_1();
 	test_xml_parse_document_2();
 	test_xml_parse_document_3();
+	test_xml_parse_document_4();
+	test_xml_parse_document_5();
+	test_xml_parse_document_6();
 	test_xml_parse_attributes();
+	test_xml_parse_attributes_1();
+	test_xml_symbols();
+	test_xml_named_children();
+	test_xml_parse_lazy();
+	test_xml_parse_parallel();
+	test_xml_document_parser();
+	test_xml_allocator();
+	test_xml_error();
+	test_xml_validate();
+	test_xml_parse_batch();
+	test_xml_decode();
+	test_xml_write();
+	test_xml_query();
+	test_xml_reader();
+	test_xml_push_parser();
 
 	fprintf(stdout, "All tests passed :-)\n");
 	exit(EXIT_SUCCESS);
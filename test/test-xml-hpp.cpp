@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2012 ooxi/xml.c
+ *     https://github.com/ooxi/xml.c
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software in a
+ *     product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ * 
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *
+ *  3. This notice may not be removed or altered from any source distribution.
+ */
+ 
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <xml.hpp>
+
+/**
+ * Will halt the program iff assertion fails
+ */
+static void _assert_that(bool condition, const char* message,
+  const char* func, const char* file, int line) {
+	if (!condition) {
+	  std::cerr << "Assertion failed: " << message << ", in " << func << " ("
+	    << file << ":" << line << ")\n";
+		exit(EXIT_FAILURE);
+	}
+}
+
+#define assert_that(condition, message) \
+  _assert_that(condition, message, __func__, __FILE__, __LINE__)
+
+static_assert(!std::is_copy_constructible<xml::document>::value,
+  "xml::document must not be copyable");
+static_assert(std::is_nothrow_move_constructible<xml::document>::value,
+  "xml::document must be movable without throwing");
+
+
+/**
+ * Converts a static character array to an uint8_t data source which can be
+ * freed
+ */
+#define SOURCE(source, content)								\
+	uint8_t* source = (uint8_t*)calloc(strlen(content) + 1, sizeof(uint8_t));	\
+	memcpy(source, (content), strlen(content) + 1);					\
+
+
+/**
+ * Names, contents and attributes are views into the parsed buffer
+ */
+static void test_xml_hpp_views() {
+	SOURCE(source, "<Hello lang=\"en\" empty=\"\">World</Hello>");
+	{
+		xml::document document = xml::document::parse(source, strlen((const char*)source));
+		assert_that(bool(document), "Could not parse document");
+
+		xml::node root = document.root();
+		assert_that(root.name() == "Hello", "root node name must be `Hello'");
+		assert_that(root.content() == "World", "root node content must be `World'");
+		assert_that(root.name().data() >= (char const*)source
+		  && root.name().data() < (char const*)source + strlen((const char*)source),
+		  "root node name must point into the source buffer");
+
+		assert_that(2 == root.attributes().size(), "root must have two attributes");
+		assert_that(root.attributes()[0].name() == "lang", "first attribute must be `lang'");
+		assert_that(root.attribute_content("lang") == "en", "attribute `lang' must be `en'");
+		assert_that(root.attribute_content("empty").empty(), "attribute `empty' must be empty");
+		assert_that(root.attribute_content("missing").empty(), "missing attribute must be empty");
+		assert_that(root.children().empty(), "root must not have children");
+	}
+	free(source);
+}
+
+/**
+ * Range iteration over children and lookup by name
+ */
+static void test_xml_hpp_children() {
+	SOURCE(source, ""
+		"<Parent>\n"
+		"\t<Child>First content</Child>\n"
+		"\t<Other />\n"
+		"\t<Child>Second content</Child>\n"
+		"</Parent>\n"
+	);
+	xml::document document = xml::document::parse(source, strlen((const char*)source));
+	assert_that(bool(document), "Could not parse document");
+	xml::node root = document.root();
+
+	size_t children = 0;
+	size_t named_child = 0;
+	for (xml::node child : root.children()) {
+		++children;
+		if (child.symbol() == document.symbol("Child")) {
+			++named_child;
+		}
+	}
+	assert_that(3 == children, "root must have three children");
+	assert_that(2 == named_child, "root must have two children named `Child'");
+	assert_that(root.children().end() - root.children().begin() == 3,
+	  "children range must be random access");
+
+	std::uint32_t child = document.symbol("Child");
+	assert_that(!root.child("Child"), "`Child' is ambiguous, like in xml_easy_child");
+	assert_that(2 == root.named_children(child), "root must have two children named `Child'");
+	assert_that(root.named_child(child, 1).content() == "Second content",
+	  "second `Child' must be found by symbol");
+	assert_that(root.child("Other") && (root.child("Other") == root.child_by_symbol(document.symbol("Other"))),
+	  "`Other' must be found by name and by symbol");
+	assert_that(root.child(1).name() == "Other", "second child must be `Other'");
+	assert_that(root.child(1).content().empty(), "`Other' must not have content");
+
+	xml::node missing = root.child("Missing");
+	assert_that(!missing, "Parent/Missing must be a null node");
+	assert_that(!root.child(3), "Parent must not have a fourth child");
+	assert_that(missing.name().empty() && missing.children().empty()
+	  && missing.child("Child") == xml::node(),
+	  "null node must have no name and no children");
+	assert_that(0 == document.symbol("Missing"), "`Missing' must not be interned");
+
+	xml_document_free(document.release(), true);
+	assert_that(!document, "released document must be empty");
+
+	/* Names of lazy nodes' children are only known once accessed
+	 */
+	SOURCE(lazy_source, "<Parent><A><B>text</B></A></Parent>");
+	struct xml_options options = {0};
+	options.lazy = true;
+	xml::document lazy = xml::document::parse(lazy_source, strlen((const char*)lazy_source), &options);
+	assert_that(lazy.root().child("A").child("B").content() == "text", "lazy children must be found by name");
+	lazy.reset();
+	free(lazy_source);
+}
+
+/**
+ * Ownership moves between documents and failed parses yield empty documents
+ */
+static void test_xml_hpp_ownership() {
+	SOURCE(source, "<Root><Child /></Root>");
+	xml::document first = xml::document(xml_parse_document(source, strlen((const char*)source)), true);
+	assert_that(bool(first), "Could not parse document");
+
+	xml::document second = std::move(first);
+	assert_that(!first && bool(second), "move must transfer ownership");
+	assert_that(second.root().name() == "Root", "moved document must keep its root");
+
+	first = std::move(second);
+	assert_that(bool(first) && !second, "move assignment must transfer ownership");
+	first.reset();
+	assert_that(!first && !first.root(), "reset document must be empty");
+
+	SOURCE(broken, "<Root><Child></Root>");
+	xml::document invalid = xml::document::parse(broken, strlen((const char*)broken));
+	assert_that(!invalid, "mismatched tags must not parse");
+	free(broken);
+
+	struct xml_error error;
+	struct xml_options options = {0};
+	options.error = &error;
+	assert_that(!xml::document::open("does-not-exist.xml", &options), "missing file must not be opened");
+	assert_that(XML_ERROR_READ == error.code, "missing file must be reported");
+
+	xml::document opened = xml::document::open("test.xml", &options);
+	assert_that(bool(opened), "Cannot parse test.xml");
+	assert_that(opened.root().child("Element").child("With").content() == "Child",
+	  "Content of Document/Element/With must be `Child'");
+}
+
+int main(int argc, char **argv) {
+  test_xml_hpp_views();
+  test_xml_hpp_children();
+  test_xml_hpp_ownership();
+  std::cout << "All tests passed :-)\n";
+  exit(EXIT_SUCCESS);
+}
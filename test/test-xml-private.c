@@ -0,0 +1,282 @@
+/**
+ * Copyright (c) 2012 ooxi/xml.c
+ *     https://github.com/ooxi/xml.c
+ *
+ * This software is provided 'as-is', without any express or implied warranty.
+ * In no event will the authors be held liable for any damages arising from the
+ * use of this software.
+ * 
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ *  1. The origin of this software must not be misrepresented; you must not
+ *     claim that you wrote the original software. If you use this software in a
+ *     product, an acknowledgment in the product documentation would be
+ *     appreciated but is not required.
+ * 
+ *  2. Altered source versions must be plainly marked as such, and must not be
+ *     misrepresented as being the original software.
+ *
+ *  3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* White box tests need access to the parser's private functions
+ */
+#define XML_PARSER_STATISTICS
+#include "xml.c"
+
+
+
+
+
+/**
+ * Will halt the program iff assertion fails
+ */
+static void _assert_that(_Bool condition, char const* message, char const* func, char const* file, int line) {
+	if (!condition) {
+		fprintf(stderr, "Assertion failed: %s, in %s (%s:%i)\n", message, func, file, line);
+		exit(EXIT_FAILURE);
+	}
+}
+
+#define assert_that(condition, message)					\
+	_assert_that(condition, message, __func__, __FILE__, __LINE__)	
+
+
+
+/**
+ * Compares the kernels against the scalar reference implementation on every
+ * suffix of a buffer mixing whitespace, markup and text
+ */
+static void test_xml_scanner_kernels(struct xml_scanner const* scanner) {
+	uint8_t buffer[256];
+	uint8_t const alphabet[] = " \t\r\nab<>/='\"";
+
+	uint32_t random = 42;
+	size_t i = 0; for (; i < sizeof(buffer); ++i) {
+		random = random * 1103515245 + 12345;
+
+		/* Long runs of the same class cross vector boundaries
+		 */
+		size_t class = (random >> 16) % (sizeof(alphabet) - 1);
+		buffer[i] = (i % 64 < 40) ? (i % 64 < 20 ? 'x' : ' ') : alphabet[class];
+	}
+
+	size_t position = 0; for (; position <= sizeof(buffer); ++position) {
+		size_t length = sizeof(buffer) - (position % 7);
+		if (position > length) {
+			continue;
+		}
+
+		assert_that(
+			scanner->whitespace(buffer, position, length) == xml_scanner_scalar.whitespace(buffer, position, length),
+			"whitespace kernel must match scalar implementation"
+		);
+		assert_that(
+			scanner->name_end(buffer, position, length) == xml_scanner_scalar.name_end(buffer, position, length),
+			"name_end kernel must match scalar implementation"
+		);
+		assert_that(
+			scanner->depth(buffer, position, length) == xml_scanner_scalar.depth(buffer, position, length),
+			"depth kernel must match scalar implementation"
+		);
+
+		size_t j = 0; for (; j < sizeof(alphabet) - 1; ++j) {
+			assert_that(
+				scanner->byte(buffer, position, length, alphabet[j]) == xml_scanner_scalar.byte(buffer, position, length, alphabet[j]),
+				"byte kernel must match scalar implementation"
+			);
+			assert_that(
+				scanner->either(buffer, position, length, alphabet[j], '=') == xml_scanner_scalar.either(buffer, position, length, alphabet[j], '='),
+				"either kernel must match scalar implementation"
+			);
+		}
+	}
+}
+
+
+
+/**
+ * Generates `depth' nested elements, each level indented by `indentation'
+ * spaces more than its parent
+ */
+static uint8_t* generate_nested_document(size_t depth, size_t indentation, size_t* length) {
+	size_t capacity = 2 * depth * (depth * indentation + 64) + 64;
+	uint8_t* buffer = malloc(capacity);
+	size_t position = 0;
+
+	size_t level = 0; for (; level < depth; ++level) {
+		memset(&buffer[position], ' ', level * indentation);
+		position += level * indentation;
+		position += sprintf((char*)&buffer[position], "<Level depth=\"%i\">\n", (int)level);
+	}
+
+	memset(&buffer[position], ' ', depth * indentation);
+	position += depth * indentation;
+	position += sprintf((char*)&buffer[position], "<Leaf>Content</Leaf>\n");
+
+	while (level--) {
+		memset(&buffer[position], ' ', level * indentation);
+		position += level * indentation;
+		position += sprintf((char*)&buffer[position], "</Level>\n");
+	}
+
+	*length = position;
+	return buffer;
+}
+
+
+
+/**
+ * Parses the same document with growing indentation, the lexer must not peek
+ * at whitespace but skip it using the scanning kernels
+ */
+static void test_xml_parser_peeks() {
+	size_t peeks_without_indentation = 0;
+
+	size_t indentation = 0; for (; indentation <= 64; indentation += 16) {
+		size_t length;
+		uint8_t* buffer = generate_nested_document(32, indentation, &length);
+
+		xml_parser_peeks = 0;
+		struct xml_document* document = xml_parse_document(buffer, length);
+		assert_that(document, "Could not parse document");
+
+		if (!indentation) {
+			peeks_without_indentation = xml_parser_peeks;
+			assert_that(xml_parser_peeks < length, "Lexer must peek less than once per byte");
+		} else {
+			assert_that(xml_parser_peeks == peeks_without_indentation, "Peeks must not depend on indentation");
+		}
+
+		xml_document_free(document, true);
+	}
+}
+
+
+
+/**
+ * Reports the size of a node and the memory a document needs per node, which
+ * must not grow unnoticed
+ */
+static void test_xml_node_size() {
+	size_t const children = 10000;
+	uint8_t* buffer = malloc(children * 32 + 64);
+	size_t length = sprintf((char*)buffer, "<Root>");
+	size_t i = 0; for (; i < children; ++i) {
+		length += sprintf((char*)&buffer[length], "<Item>%i</Item>", (int)i);
+	}
+	length += sprintf((char*)&buffer[length], "</Root>");
+
+	struct xml_document* document = xml_parse_document(buffer, length);
+	assert_that(document, "Could not parse document");
+
+	double per_node = (double)xml_document_memory(document) / (children + 1);
+	fprintf(stdout, "sizeof(struct xml_node) = %zu bytes, document memory = %.1f bytes per node\n", sizeof(struct xml_node), per_node);
+
+	assert_that(sizeof(struct xml_node) <= 64, "node must not grow");
+	assert_that(per_node <= sizeof(struct xml_node) + sizeof(struct xml_node*) + 16, "document must not need much more than node and child pointer per node");
+
+	xml_document_free(document, true);
+}
+
+
+
+/**
+ * Threads of a pool are started once and reused by all phases of parallel
+ * parsing and by batches, whose workers steal the shares of workers not
+ * started yet if there are fewer threads than shares
+ */
+#ifdef XML_PARSER_THREADS
+static void test_xml_pool() {
+	size_t const children = 40000;
+	uint8_t* large = malloc(children * 32 + 64);
+	size_t length = sprintf((char*)large, "<Root>");
+	size_t i = 0; for (; i < children; ++i) {
+		length += sprintf((char*)&large[length], "<Item id='%i'>%i</Item>", (int)i, (int)i);
+	}
+	length += sprintf((char*)&large[length], "</Root>");
+	assert_that(length > 3 * XML_PARALLEL_MINIMUM_CHUNK_SIZE, "document must be large enough to be split");
+
+	/* Threads started per document, not per phase
+	 */
+	struct xml_options options = {0};
+	options.threads = 3;
+	xml_pool_threads_started = 0;
+
+	struct xml_document* document = xml_parse_document_ex(large, length, &options);
+	assert_that(document, "Could not parse document");
+	assert_that(2 == xml_pool_threads_started, "all phases must share the same threads");
+	xml_document_free(document, false);
+
+	/* No threads are started anymore once there is a pool
+	 */
+	options.pool = xml_pool_create(&options);
+	assert_that(options.pool && (4 == xml_pool_threads_started), "pool must start its threads");
+
+	for (i = 0; i < 3; ++i) {
+		document = xml_parse_document_ex(large, length, &options);
+		assert_that(document && (children == xml_node_children(xml_document_root(document))), "Could not parse document using pool");
+		xml_document_free(document, false);
+	}
+	assert_that(4 == xml_pool_threads_started, "documents must be parsed by the pool's threads");
+
+	/* More shares than threads, the shares not started yet are stolen
+	 */
+	size_t const documents = 1000;
+	struct xml_batch_input* inputs = calloc(documents, sizeof(struct xml_batch_input));
+	struct xml_batch_output* outputs = calloc(documents, sizeof(struct xml_batch_output));
+	uint8_t* buffer = calloc(documents, 32);
+	assert_that(inputs && outputs && buffer, "out of memory");
+
+	for (i = 0; i < documents; ++i) {
+		inputs[i].buffer = &buffer[i * 32];
+		inputs[i].length = sprintf((char*)inputs[i].buffer, "<Id>%i</Id>", (int)i);
+	}
+
+	options.threads = 8;
+	xml_batch_steals = 0;
+	assert_that(documents == xml_parse_batch(inputs, documents, outputs, &options), "all documents must be parsed");
+	assert_that(xml_batch_steals > 0, "shares must be stolen");
+	assert_that(4 == xml_pool_threads_started, "batch must be parsed by the pool's threads");
+
+	for (i = 0; i < documents; ++i) {
+		char expected[16];
+		sprintf(expected, "%i", (int)i);
+		struct xml_string* content = xml_node_content(xml_document_root(outputs[i].document));
+
+		assert_that((strlen(expected) == content->length) && !memcmp(expected, content->buffer, content->length), "results must be in input order");
+		xml_document_free(outputs[i].document, false);
+	}
+
+	xml_pool_free(options.pool);
+	free(buffer);
+	free(outputs);
+	free(inputs);
+	free(large);
+}
+#endif
+
+
+
+/**
+ * Console interface
+ */
+int main(int argc, char** argv) {
+	test_xml_scanner_kernels(xml_scanner_select());
+
+	#ifdef XML_PARSER_X86_KERNELS
+	test_xml_scanner_kernels(&xml_scanner_sse2);
+	#endif
+
+	test_xml_parser_peeks();
+	test_xml_node_size();
+
+	#ifdef XML_PARSER_THREADS
+	test_xml_pool();
+	#endif
+
+	fprintf(stdout, "All tests passed :-)\n");
+	exit(EXIT_SUCCESS);
+}